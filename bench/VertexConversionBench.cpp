@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include <glm/geometric.hpp>
+
+#include "vk/VertexConversion.hpp"
+
+// compares the batched attribute stream conversion with the per vertex conversion that it replaced
+// usage: VertexConversionBench [vertex count] [iterations]
+
+namespace
+{
+    // tightly packed streams like the ones of most glb files
+    struct Streams {
+        std::vector<float> positions;
+        std::vector<float> normals;
+        std::vector<float> colors;
+        std::vector<float> tex_coords;
+    };
+
+    Streams create_streams(std::size_t count)
+    {
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+        Streams streams;
+        for (std::size_t i = 0; i < count * 3; ++i) streams.positions.push_back(dist(rng) * 100.0f);
+        for (std::size_t i = 0; i < count * 3; ++i) streams.normals.push_back(dist(rng));
+        for (std::size_t i = 0; i < count * 4; ++i) streams.colors.push_back(std::abs(dist(rng)));
+        for (std::size_t i = 0; i < count * 2; ++i) streams.tex_coords.push_back(std::abs(dist(rng)));
+        return streams;
+    }
+
+    void convert_per_vertex(const Streams& streams, std::size_t count, const glm::mat4& matrix, ve::Vertex* vertices)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const glm::vec4 pos = matrix * glm::vec4(streams.positions[i * 3], streams.positions[i * 3 + 1], streams.positions[i * 3 + 2], 1.0f);
+            vertices[i].pos = glm::vec3(pos) / pos.w;
+            vertices[i].normal = glm::normalize(glm::vec3(streams.normals[i * 3], streams.normals[i * 3 + 1], streams.normals[i * 3 + 2]));
+            vertices[i].color = glm::vec4(streams.colors[i * 4], streams.colors[i * 4 + 1], streams.colors[i * 4 + 2], streams.colors[i * 4 + 3]);
+            vertices[i].tex = glm::vec2(streams.tex_coords[i * 2], streams.tex_coords[i * 2 + 1]);
+        }
+    }
+
+    void convert_batched(const Streams& streams, std::size_t count, const glm::mat4& matrix, ve::Vertex* vertices)
+    {
+        ve::VertexConversion::transform_positions({streams.positions.data(), 3}, count, matrix, vertices);
+        ve::VertexConversion::normalize_normals({streams.normals.data(), 3}, count, vertices);
+        ve::VertexConversion::copy_colors({streams.colors.data(), 4}, 4, count, glm::vec4(1.0f), vertices);
+        ve::VertexConversion::copy_tex_coords({streams.tex_coords.data(), 2}, count, vertices);
+    }
+
+    // best time of all iterations in milliseconds
+    template<typename F>
+    double measure(uint32_t iterations, F&& f)
+    {
+        double best = 1e30;
+        for (uint32_t i = 0; i < iterations; ++i)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            f();
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+}// namespace
+
+int main(int argc, char** argv)
+{
+    const std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+    const uint32_t iterations = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20;
+    const Streams streams = create_streams(count);
+    glm::mat4 matrix(1.0f);
+    matrix[0][0] = 2.0f;
+    matrix[1][2] = 0.5f;
+    matrix[3] = glm::vec4(1.0f, 2.0f, 3.0f, 1.0f);
+
+    std::vector<ve::Vertex> reference(count);
+    std::vector<ve::Vertex> batched(count);
+    const double per_vertex_ms = measure(iterations, [&]() { convert_per_vertex(streams, count, matrix, reference.data()); });
+    const double batched_ms = measure(iterations, [&]() { convert_batched(streams, count, matrix, batched.data()); });
+
+    // the SIMD paths may round differently, but have to agree with the reference within a small tolerance
+    float max_error = 0.0f;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        max_error = std::max(max_error, glm::length(reference[i].pos - batched[i].pos) / std::max(1.0f, glm::length(reference[i].pos)));
+        max_error = std::max(max_error, glm::length(reference[i].normal - batched[i].normal));
+        max_error = std::max(max_error, glm::length(reference[i].color - batched[i].color));
+        max_error = std::max(max_error, glm::length(reference[i].tex - batched[i].tex));
+    }
+
+    std::printf("vertices: %zu, iterations: %u\n", count, iterations);
+    std::printf("per vertex: %8.3f ms (%6.2f Mvertices/s)\n", per_vertex_ms, count / per_vertex_ms / 1000.0);
+    std::printf("batched:    %8.3f ms (%6.2f Mvertices/s)\n", batched_ms, count / batched_ms / 1000.0);
+    std::printf("speedup:    %8.2fx, max relative error: %g\n", per_vertex_ms / batched_ms, max_error);
+    return max_error < 1e-4f ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// read only memory mapping of a whole file with mmap or MapViewOfFile, the mapping is released when the object is destroyed
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    ~MappedFile();
+    bool is_open() const;
+    const unsigned char* data() const;
+    std::size_t size() const;
+
+private:
+    const unsigned char* mapped_data = nullptr;
+    std::size_t byte_size = 0;
+
+    void unmap();
+};
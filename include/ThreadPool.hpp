@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed number of worker threads that execute submitted tasks in submission order
+// tasks must not wait for other tasks of the same pool, as all workers could end up waiting
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t thread_count);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    template<class F>
+    std::future<std::invoke_result_t<F>> submit(F&& task)
+    {
+        using R = std::invoke_result_t<F>;
+        auto packaged_task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packaged_task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged_task]() { (*packaged_task)(); });
+        }
+        condition.notify_one();
+        return result;
+    }
+
+private:
+    std::vector<std::thread> threads;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stop = false;
+
+    void work();
+};
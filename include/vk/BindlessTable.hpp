@@ -0,0 +1,49 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/Buffer.hpp"
+#include "vk/Defragmenter.hpp"
+#include "vk/Image.hpp"
+#include "vk/common.hpp"
+
+namespace ve
+{
+    // one descriptor set with the materials of the whole scene in a storage buffer and all of their textures in one array
+    // binding 0 is the material table, binding 1 the texture array that the materials index
+    class BindlessTable
+    {
+    public:
+        BindlessTable(const VulkanMainContext& vmc);
+        static bool is_supported(const VulkanMainContext& vmc);
+        // materials and textures that were added before are not added again, nullptr is the default material
+        uint32_t add_material(const Material* material);
+        // creates the material table and writes all textures, has to be called after all materials were added
+        void construct();
+        // rewrites the textures whose views were recreated, the set must not be in use
+        void relocate(const Defragmenter::Relocations& relocations);
+        void self_destruct();
+        vk::DescriptorSetLayout get_layout() const;
+        vk::DescriptorSet get_set() const;
+
+    private:
+        // upper limit of the texture array, lowered to the limits of the device
+        static constexpr uint32_t max_textures = 16384;
+
+        const VulkanMainContext& vmc;
+        uint32_t texture_capacity;
+        vk::DescriptorSetLayout layout;
+        vk::DescriptorPool pool;
+        vk::DescriptorSet set;
+        Buffer material_buffer;
+        std::vector<ShaderMaterial> materials;
+        std::unordered_map<const Material*, uint32_t> material_indices;
+        // indexed like the texture array
+        std::vector<vk::DescriptorImageInfo> textures;
+        std::unordered_map<const Image*, uint32_t> texture_indices;
+
+        uint32_t add_texture(const Image* image);
+    };
+}// namespace ve
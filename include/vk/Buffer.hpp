@@ -4,7 +4,8 @@
 #include <vulkan/vulkan.hpp>
 
 #include "ve_log.hpp"
-#include "vk/VulkanCommandContext.hpp"
+#include "vk/Defragmenter.hpp"
+#include "vk/UploadContext.hpp"
 #include "vk/VulkanMainContext.hpp"
 
 namespace ve
@@ -15,26 +16,50 @@ namespace ve
         Buffer() = default;
 
         template<class T>
-        Buffer(const VulkanMainContext& vmc, const T* data, std::size_t elements, vk::BufferUsageFlags usage_flags, const std::vector<uint32_t>& queue_family_indices) : vmc(&vmc), device_local(false), element_count(elements), byte_size(sizeof(T) * elements)
+        Buffer(const VulkanMainContext& vmc, const T* data, std::size_t elements, vk::BufferUsageFlags usage_flags, const std::vector<uint32_t>& queue_family_indices, AllocationClass allocation_class) : vmc(&vmc), device_local(false), element_count(elements), byte_size(sizeof(T) * elements)
         {
-            std::tie(buffer, vmaa) = create_buffer(usage_flags, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, queue_family_indices);
-            update_data(data, elements);
+            // host visible buffers stay mapped for their whole lifetime
+            VmaAllocationInfo vai;
+            std::tie(buffer, vmaa) = create_buffer(usage_flags, allocation_class, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, queue_family_indices, &vai);
+            mapped = static_cast<unsigned char*>(vai.pMappedData);
+            VkMemoryPropertyFlags memory_properties;
+            vmaGetAllocationMemoryProperties(vmc.va, vmaa, &memory_properties);
+            host_coherent = memory_properties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+            write(data, elements);
         }
 
         template<class T>
-        Buffer(const VulkanMainContext& vmc, const std::vector<T>& data, vk::BufferUsageFlags usage_flags, const std::vector<uint32_t>& queue_family_indices) : Buffer(vmc, data.data(), data.size(), usage_flags, queue_family_indices)
+        Buffer(const VulkanMainContext& vmc, const std::vector<T>& data, vk::BufferUsageFlags usage_flags, const std::vector<uint32_t>& queue_family_indices, AllocationClass allocation_class) : Buffer(vmc, data.data(), data.size(), usage_flags, queue_family_indices, allocation_class)
         {}
 
+        // device local buffer that is exclusively owned by the graphics queue family, the data is copied by the upload batch
         template<class T>
-        Buffer(const VulkanMainContext& vmc, const std::vector<T>& data, vk::BufferUsageFlags usage_flags, std::vector<uint32_t> queue_family_indices, const VulkanCommandContext& vcc) : vmc(&vmc), device_local(true), element_count(data.size()), byte_size(sizeof(T) * data.size())
+        Buffer(const VulkanMainContext& vmc, const T* data, std::size_t elements, vk::BufferUsageFlags usage_flags, UploadContext& upload, AllocationClass allocation_class) : vmc(&vmc), device_local(true), element_count(elements), byte_size(sizeof(T) * elements)
         {
-            std::tie(buffer, vmaa) = create_buffer((usage_flags | vk::BufferUsageFlagBits::eTransferDst), {}, queue_family_indices);
-            update_data(data, vcc);
+            std::tie(buffer, vmaa) = create_buffer((usage_flags | vk::BufferUsageFlagBits::eTransferDst), allocation_class, 0, {uint32_t(vmc.queues_family_indices.graphics)});
+            update_data(data, elements, upload);
+        }
+
+        template<class T>
+        Buffer(const VulkanMainContext& vmc, const std::vector<T>& data, vk::BufferUsageFlags usage_flags, UploadContext& upload, AllocationClass allocation_class) : Buffer(vmc, data.data(), data.size(), usage_flags, upload, allocation_class)
+        {}
+
+        // empty device local buffer that is exclusively owned by the graphics queue family, it is filled through an UploadContext
+        Buffer(const VulkanMainContext& vmc, vk::DeviceSize size, vk::BufferUsageFlags usage_flags, AllocationClass allocation_class) : vmc(&vmc), device_local(true), element_count(size), byte_size(size)
+        {
+            std::tie(buffer, vmaa) = create_buffer((usage_flags | vk::BufferUsageFlagBits::eTransferDst), allocation_class, 0, {uint32_t(vmc.queues_family_indices.graphics)});
         }
 
         void self_destruct()
         {
-            vmaDestroyBuffer(vmc->va, buffer, vmaa);
+            vmc->memory_pools.destroy_buffer(buffer, vmaa);
+        }
+
+        // switches to the new buffer if the defragmentation moved this one
+        void relocate(const Defragmenter::Relocations& relocations)
+        {
+            auto it = relocations.buffers.find(buffer);
+            if (it != relocations.buffers.end()) buffer = it->second;
         }
 
         const vk::Buffer& get() const
@@ -55,19 +80,31 @@ namespace ve
         template<class T>
         void update_data(const T& data)
         {
-            update_data(std::vector<T>{data});
+            write(data);
         }
 
         template<class T>
         void update_data(const T* data, std::size_t elements)
         {
-            VE_ASSERT(sizeof(T) * elements <= byte_size, "Data is larger than buffer!\n");
+            write(data, elements);
+        }
+
+        // writes straight into the persistent mapping, only the written range is flushed if the memory is not host coherent
+        template<class T>
+        void write(const T* data, std::size_t elements, std::size_t first_element = 0)
+        {
+            VE_ASSERT(sizeof(T) * (first_element + elements) <= byte_size, "Data is larger than buffer!\n");
             VE_ASSERT(!device_local, "Trying to update data to a buffer that is device local but it should not!\n");
 
-            void* mapped_mem;
-            vmaMapMemory(vmc->va, vmaa, &mapped_mem);
-            memcpy(mapped_mem, data, sizeof(T) * elements);
-            vmaUnmapMemory(vmc->va, vmaa);
+            const vk::DeviceSize offset = sizeof(T) * first_element;
+            memcpy(mapped + offset, data, sizeof(T) * elements);
+            if (!host_coherent) vmaFlushAllocation(vmc->va, vmaa, offset, sizeof(T) * elements);
+        }
+
+        template<class T>
+        void write(const T& data)
+        {
+            write(&data, 1);
         }
 
         template<class T>
@@ -77,37 +114,28 @@ namespace ve
         }
 
         template<class T>
-        void update_data(const T& data, const VulkanCommandContext& vcc)
+        void update_data(const T& data, UploadContext& upload)
         {
-            update_data(std::vector<T>{data}, vcc);
+            update_data(&data, 1, upload);
         }
 
         template<class T>
-        void update_data(const std::vector<T>& data, const VulkanCommandContext& vcc)
+        void update_data(const std::vector<T>& data, UploadContext& upload)
         {
-            VE_ASSERT(sizeof(T) * data.size() <= byte_size, "Data is larger than buffer!\n");
-            VE_ASSERT(device_local, "Trying to update data to a buffer that is not device local but it should!\n");
-
-            auto [staging_buffer, staging_vmaa] = create_buffer((vk::BufferUsageFlagBits::eTransferSrc), VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, {uint32_t(vmc->queues_family_indices.transfer)});
-            void* mapped_data;
-            vmaMapMemory(vmc->va, staging_vmaa, &mapped_data);
-            memcpy(mapped_data, data.data(), sizeof(T) * data.size());
-            vmaUnmapMemory(vmc->va, staging_vmaa);
-
-            const vk::CommandBuffer& cb(vcc.begin(vcc.transfer_cb[0]));
-
-            vk::BufferCopy copy_region{};
-            copy_region.srcOffset = 0;
-            copy_region.dstOffset = 0;
-            copy_region.size = sizeof(T) * data.size();
-            cb.copyBuffer(staging_buffer, buffer, copy_region);
-            vcc.submit_transfer(cb, true);
+            update_data(data.data(), data.size(), upload);
+        }
 
-            vmaDestroyBuffer(vmc->va, staging_buffer, staging_vmaa);
+        // the copy is recorded into the upload batch, the buffer must not be used before the batch is flushed
+        template<class T>
+        void update_data(const T* data, std::size_t elements, UploadContext& upload)
+        {
+            VE_ASSERT(sizeof(T) * elements <= byte_size, "Data is larger than buffer!\n");
+            VE_ASSERT(device_local, "Trying to update data to a buffer that is not device local but it should!\n");
+            upload.copy_to_buffer(data, sizeof(T) * elements, buffer, 0);
         }
 
     private:
-        std::pair<vk::Buffer, VmaAllocation> create_buffer(vk::BufferUsageFlags usage_flags, VmaAllocationCreateFlags vma_flags, const std::vector<uint32_t>& queue_family_indices)
+        std::pair<vk::Buffer, VmaAllocation> create_buffer(vk::BufferUsageFlags usage_flags, AllocationClass allocation_class, VmaAllocationCreateFlags vma_flags, const std::vector<uint32_t>& queue_family_indices, VmaAllocationInfo* vai = nullptr)
         {
             vk::BufferCreateInfo bci{};
             bci.sType = vk::StructureType::eBufferCreateInfo;
@@ -117,14 +145,7 @@ namespace ve
             bci.flags = {};
             bci.queueFamilyIndexCount = queue_family_indices.size();
             bci.pQueueFamilyIndices = queue_family_indices.data();
-            VmaAllocationCreateInfo vaci{};
-            vaci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-            vaci.flags = vma_flags;
-            VkBuffer local_buffer;
-            VmaAllocation local_vmaa;
-            vmaCreateBuffer(vmc->va, (VkBufferCreateInfo*) (&bci), &vaci, (&local_buffer), &local_vmaa, nullptr);
-
-            return std::make_pair(local_buffer, local_vmaa);
+            return vmc->memory_pools.create_buffer(bci, allocation_class, vma_flags, vai);
         }
 
         const VulkanMainContext* vmc;
@@ -133,5 +154,8 @@ namespace ve
         uint64_t element_count;
         vk::Buffer buffer;
         VmaAllocation vmaa;
+        // only used by host visible buffers
+        unsigned char* mapped = nullptr;
+        bool host_coherent = true;
     };
 }// namespace ve
\ No newline at end of file
@@ -9,6 +9,7 @@ namespace ve
     public:
         CommandPool(const vk::Device& logical_device, uint32_t queue_family_idx);
         std::vector<vk::CommandBuffer> create_command_buffers(uint32_t count);
+        void free_command_buffers(const std::vector<vk::CommandBuffer>& command_buffers);
         void self_destruct();
 
     private:
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/VulkanCommandContext.hpp"
+#include "vk_mem_alloc.h"
+
+namespace ve
+{
+    // defragments the movable memory pools in small passes that are spread over several frames
+    // the content of moved resources is copied on the graphics queue without waiting for it, the owners switch to the new handles once the copies are finished
+    class Defragmenter
+    {
+    public:
+        // handles of the resources that were moved by a pass, indexed by their old handles
+        struct Relocations {
+            std::unordered_map<VkBuffer, vk::Buffer> buffers;
+            std::unordered_map<VkImage, vk::Image> images;
+            // filled by the owners of the moved images when they recreate their views
+            std::unordered_map<VkImageView, vk::ImageView> image_views;
+        };
+
+        // statistics of all finished defragmentations
+        struct Stats {
+            uint64_t defragmentations = 0;
+            vk::DeviceSize bytes_moved = 0;
+            vk::DeviceSize bytes_freed = 0;
+            uint64_t allocations_moved = 0;
+            uint64_t blocks_freed = 0;
+        };
+
+        Defragmenter(const VulkanMainContext& vmc, VulkanCommandContext& vcc, uint32_t frames_in_flight);
+        // advances the defragmentation by one step, has to be called once per frame after the fence of the frame was waited for
+        // new passes are only started if can_begin is true, i.e. if no upload writes to the movable resources
+        // the returned relocations have to be applied to all owners of movable resources before the next frame is recorded
+        std::optional<Relocations> update(bool can_begin);
+        // waits for the copies of the current pass, afterwards the movable resources can be written again
+        std::optional<Relocations> finish();
+        const Stats& get_stats() const;
+        void self_destruct();
+
+    private:
+        enum class State
+        {
+            // no pass is started
+            Idle,
+            // the copies of the pass are submitted
+            Copying,
+            // the owners use the new resources, the old ones are destroyed once no frame uses them any more
+            Retiring
+        };
+
+        struct Move {
+            VmaAllocation vmaa;
+            MemoryPools::MovableResource old_resource;
+            MemoryPools::MovableResource new_resource;
+        };
+
+        // upper limits of one pass, resources are moved as a whole so the byte limit has to hold the largest geometry block
+        static constexpr vk::DeviceSize max_bytes_per_pass = 64 * 1024 * 1024;
+        static constexpr uint32_t max_allocations_per_pass = 16;
+        // number of frames between two checks of the fragmentation of the pools
+        static constexpr uint32_t check_interval = 600;
+        static constexpr std::array<AllocationClass, 2> movable_classes = {AllocationClass::Geometry, AllocationClass::Texture};
+
+        const VulkanMainContext& vmc;
+        VulkanCommandContext& vcc;
+        const uint32_t frames_in_flight;
+        vk::CommandBuffer cb;
+        uint32_t fence;
+        State state = State::Idle;
+        VmaDefragmentationContext context = VK_NULL_HANDLE;
+        VmaDefragmentationPassMoveInfo pass{};
+        std::vector<Move> moves;
+        bool moves_images = false;
+        uint32_t frames_until_check = check_interval;
+        uint32_t frames_until_retired = 0;
+        Stats stats;
+
+        bool begin_defragmentation();
+        void end_defragmentation();
+        void begin_pass();
+        void record_copy(const Move& move);
+        Relocations switch_resources();
+        void end_pass();
+        bool is_copy_finished() const;
+    };
+}// namespace ve
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+namespace ve
+{
+    // allocates descriptor sets of any layout from chains of equally sized pools
+    // there is one chain per mix of descriptor types, its pools are sized for the bindings of the layouts that use it
+    // a new pool is appended whenever the last one is exhausted, so the number of sets does not have to be known in advance
+    class DescriptorAllocator
+    {
+    public:
+        DescriptorAllocator(const vk::Device& logical_device);
+        // allocates count sets of the layout that was created from bindings
+        std::vector<vk::DescriptorSet> allocate(vk::DescriptorSetLayout layout, const std::vector<vk::DescriptorSetLayoutBinding>& bindings, uint32_t count);
+        // frees all pools and with them every allocated set
+        void self_destruct();
+
+    private:
+        // number of descriptors of each type per set, sorted by type
+        using PoolSizes = std::vector<std::pair<vk::DescriptorType, uint32_t>>;
+
+        static constexpr uint32_t sets_per_pool = 256;
+
+        const vk::Device device;
+        // the last pool of a chain is the one that sets are allocated from
+        std::map<PoolSizes, std::vector<vk::DescriptorPool>> pool_chains;
+
+        void add_pool(const PoolSizes& pool_sizes, std::vector<vk::DescriptorPool>& pools);
+    };
+}// namespace ve
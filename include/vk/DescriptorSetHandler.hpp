@@ -1,13 +1,18 @@
 #pragma once
 
+#include <optional>
 #include <vulkan/vulkan.hpp>
 
 #include "vk/Buffer.hpp"
+#include "vk/DescriptorAllocator.hpp"
 #include "vk/Image.hpp"
 #include "vk/VulkanMainContext.hpp"
 
 namespace ve
 {
+    // all sets of a handler share the bindings and therefore one layout of the layout cache
+    // sets that have a descriptor for every binding are written with one update template that is generated from the bindings
+    // with push descriptors no sets are allocated, the descriptors of a set are pushed to the command buffer when it is bound
     class DescriptorSetHandler
     {
     public:
@@ -18,30 +23,65 @@ namespace ve
         void add_descriptor(uint32_t binding, const Buffer& buffer);
         void apply_descriptor_to_new_sets(uint32_t binding, const Buffer& buffer);
         void reset_auto_apply_bindings();
+        // has to be called before construct, requires LogicalDevice::supports_push_descriptors()
+        void use_push_descriptors();
         void construct();
+        // binds the set, or pushes its descriptors, as the set of the given frequency
+        // only binds if the set is not bound already, reset_binding() has to be called for every new command buffer
+        void bind(const vk::CommandBuffer& cb, vk::PipelineLayout pipeline_layout, DescriptorSetFrequency frequency, uint32_t set);
+        void reset_binding();
+        bool has_bindings() const;
+        // replaces the descriptor of the binding in a constructed set, e.g. for streamed textures, the set must not be in use
+        void update_descriptor(uint32_t set, uint32_t binding, const Image& image);
+        void update_descriptor(uint32_t set, uint32_t binding, const Buffer& buffer);
+        // rewrites the descriptors that refer to relocated buffers or image views, the sets must not be in use
+        void relocate(const Defragmenter::Relocations& relocations);
         void self_destruct();
-        const std::vector<vk::DescriptorSetLayout>& get_layouts() const;
+        vk::DescriptorSetLayout get_layout() const;
+        // empty if push descriptors are used
         const std::vector<vk::DescriptorSet>& get_sets() const;
 
     private:
+        // the sorted descriptors of a set are the payload of the update template, which reads info with a stride of sizeof(Descriptor)
         struct Descriptor {
-            Descriptor(uint32_t binding, vk::DescriptorBufferInfo dbi, vk::DescriptorImageInfo dii) : binding(binding), dbi(dbi), dii(dii)
-            {}
+            Descriptor(uint32_t binding, const vk::DescriptorBufferInfo& dbi) : binding(binding), is_image(false)
+            {
+                info.buffer = dbi;
+            }
+            Descriptor(uint32_t binding, const vk::DescriptorImageInfo& dii) : binding(binding), is_image(true)
+            {
+                info.image = dii;
+            }
             uint32_t binding;
-            vk::DescriptorBufferInfo dbi;
-            vk::DescriptorImageInfo dii;
+            bool is_image;
+            union {
+                VkDescriptorBufferInfo buffer;
+                VkDescriptorImageInfo image;
+            } info;
             bool operator<(const Descriptor& b) const
             {
                 return (binding < b.binding);
             }
         };
 
+        // upper limit of the bindings of a push descriptor layout, the spec guarantees at least 32
+        static constexpr uint32_t max_push_descriptors = 8;
+
         const VulkanMainContext& vmc;
+        bool push_descriptors = false;
         std::vector<Descriptor> new_set_descriptors;
         std::vector<std::vector<Descriptor>> descriptor_sets;
         std::vector<vk::DescriptorSetLayoutBinding> layout_bindings;
-        std::vector<vk::DescriptorSetLayout> layouts;
-        vk::DescriptorPool pool;
+        vk::DescriptorSetLayout layout;
+        DescriptorAllocator allocator;
+        vk::DescriptorUpdateTemplate update_template;
         std::vector<vk::DescriptorSet> sets;
+        std::optional<uint32_t> bound_set;
+
+        void create_update_template();
+        void write_set(uint32_t set);
+        // dst_set is ignored for push descriptors
+        vk::WriteDescriptorSet get_write(const Descriptor& descriptor, vk::DescriptorSet dst_set) const;
+        Descriptor& find_descriptor(uint32_t set, uint32_t binding);
     };
 }// namespace ve
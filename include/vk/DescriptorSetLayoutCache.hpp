@@ -0,0 +1,40 @@
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/LogicalDevice.hpp"
+
+namespace ve
+{
+    // device wide cache that creates one descriptor set layout per distinct list of bindings
+    // the layouts live as long as the device, so users must not destroy them
+    class DescriptorSetLayoutCache
+    {
+    public:
+        DescriptorSetLayoutCache(const LogicalDevice& logical_device);
+        // the order of the bindings does not matter, binding_flags is either empty or indexed like bindings
+        vk::DescriptorSetLayout get(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, vk::DescriptorSetLayoutCreateFlags flags = {}, const std::vector<vk::DescriptorBindingFlags>& binding_flags = {}) const;
+        void self_destruct();
+
+    private:
+        struct Key {
+            vk::DescriptorSetLayoutCreateFlags flags;
+            // sorted by binding
+            std::vector<vk::DescriptorSetLayoutBinding> bindings;
+            // empty if no binding has flags
+            std::vector<vk::DescriptorBindingFlags> binding_flags;
+            bool operator==(const Key& other) const;
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key& key) const;
+        };
+
+        const LogicalDevice& logical_device;
+        mutable std::mutex mutex;
+        mutable std::unordered_map<Key, vk::DescriptorSetLayout, KeyHash> layouts;
+    };
+}// namespace ve
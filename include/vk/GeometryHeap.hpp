@@ -0,0 +1,78 @@
+#pragma once
+
+#include <map>
+#include <optional>
+#include <span>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/Buffer.hpp"
+#include "vk/UploadContext.hpp"
+
+namespace ve
+{
+    // shared vertex and index buffers that the geometry of many models is sub-allocated from
+    // as long as everything fits into the first block, one vertex buffer bind serves all draws
+    class GeometryHeap
+    {
+    public:
+        // region of a block that holds the vertices and indices of one model
+        struct Allocation {
+            uint32_t block = 0;
+            vk::DeviceSize vertex_offset = 0;
+            vk::DeviceSize vertex_size = 0;
+            vk::DeviceSize index_offset = 0;
+            vk::DeviceSize index_size = 0;
+            // offset of the region in vertices, has to be added to the vertex offsets of the meshes
+            int32_t first_vertex = 0;
+
+            // offset of the region in indices of the given type, has to be added to the index offsets of the meshes
+            uint32_t get_first_index(vk::IndexType index_type) const
+            {
+                return uint32_t(index_offset / (index_type == vk::IndexType::eUint16 ? sizeof(uint16_t) : sizeof(uint32_t)));
+            }
+        };
+
+        GeometryHeap(const VulkanMainContext& vmc);
+        // the vertex region is aligned to vertex_stride so that it can be addressed with a vertex offset
+        Allocation allocate(vk::DeviceSize vertex_size, vk::DeviceSize vertex_stride, vk::DeviceSize index_size);
+        void free(const Allocation& allocation);
+        void upload(UploadContext& upload, const Allocation& allocation, std::span<const unsigned char> vertex_data, std::span<const unsigned char> index_data);
+        // only binds the buffers of block if they are not bound already, reset_binding() has to be called for every new command buffer
+        void bind(const vk::CommandBuffer& cb, uint32_t block, vk::IndexType index_type);
+        void reset_binding();
+        void relocate(const Defragmenter::Relocations& relocations);
+        void self_destruct();
+
+    private:
+        // first fit free list, neighbouring free ranges are merged
+        class RangeAllocator
+        {
+        public:
+            explicit RangeAllocator(vk::DeviceSize size);
+            std::optional<vk::DeviceSize> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+            void free(vk::DeviceSize offset, vk::DeviceSize size);
+
+        private:
+            // offset and size of the free ranges
+            std::map<vk::DeviceSize, vk::DeviceSize> free_ranges;
+        };
+
+        struct Block {
+            Buffer vertex_buffer;
+            Buffer index_buffer;
+            RangeAllocator vertex_ranges;
+            RangeAllocator index_ranges;
+        };
+
+        // blocks that are larger are only created for models that would not fit otherwise
+        static constexpr vk::DeviceSize vertex_block_size = 64 * 1024 * 1024;
+        static constexpr vk::DeviceSize index_block_size = 32 * 1024 * 1024;
+        // index offsets have to be a multiple of the size of 16 bit and 32 bit indices
+        static constexpr vk::DeviceSize index_alignment = sizeof(uint32_t);
+
+        const VulkanMainContext& vmc;
+        std::vector<Block> blocks;
+        std::optional<uint32_t> bound_block;
+        std::optional<vk::IndexType> bound_index_type;
+    };
+}// namespace ve
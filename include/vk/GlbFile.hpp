@@ -0,0 +1,50 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include "tiny_gltf.h"
+
+#include "MappedFile.hpp"
+
+namespace ve
+{
+    // memory mapped binary glTF file, tinygltf only parses the JSON chunk
+    // the buffers and embedded images are never copied out of the mapping, model.buffers do not contain any data
+    class GlbFile
+    {
+    public:
+        // elements of an accessor inside of the mapping
+        struct AccessorView {
+            const unsigned char* data;
+            std::size_t byte_stride;
+            std::size_t count;
+        };
+
+        // is_valid() is false if the file cannot be read or is not a binary glTF 2.0 file
+        explicit GlbFile(const std::string& path);
+        GlbFile(const GlbFile&) = delete;
+        GlbFile& operator=(const GlbFile&) = delete;
+        bool is_valid() const;
+        const unsigned char* data() const;
+        std::size_t size() const;
+        // parses the document into model, the encoded images are passed to image_loader like tinygltf does
+        bool load(tinygltf::Model& model, std::string* err, std::string* warn, tinygltf::LoadImageDataFunction image_loader, void* user_data);
+        std::span<const unsigned char> get_buffer_view(const tinygltf::Model& model, int buffer_view_idx) const;
+        AccessorView get_accessor(const tinygltf::Model& model, int accessor_idx) const;
+
+    private:
+        std::string base_dir;
+        MappedFile file;
+        std::span<const unsigned char> json_chunk;
+        std::span<const unsigned char> bin_chunk;
+        // buffers and images that are referenced by uri are mapped as well, only data uris have to be decoded into memory
+        std::vector<MappedFile> external_files;
+        std::vector<std::vector<unsigned char>> decoded_uris;
+        std::vector<std::span<const unsigned char>> buffers;
+
+        bool parse();
+        std::span<const unsigned char> resolve_uri(const std::string& uri, std::string* err);
+    };
+}// namespace ve
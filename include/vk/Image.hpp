@@ -1,7 +1,9 @@
 #pragma once
 
 #include "vk/Buffer.hpp"
-#include "vk/VulkanCommandContext.hpp"
+#include "vk/Defragmenter.hpp"
+#include "vk/Ktx2Texture.hpp"
+#include "vk/UploadContext.hpp"
 #include "vk_mem_alloc.h"
 
 namespace ve
@@ -10,15 +12,21 @@ namespace ve
     {
     public:
         Image(const VulkanMainContext& vmc, const std::string& name, bool use_mip_maps);
-        Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, const unsigned char* data, uint32_t width, uint32_t height, bool use_mip_maps);
-        Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, Image& src_image, uint32_t base_mip_level);
-        Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, const std::string& filename, bool use_mip_maps);
-        void create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, uint32_t width, uint32_t height, vk::SampleCountFlagBits sample_count);
-        void create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count);
+        // uploaded images are exclusively owned by the graphics queue family
+        Image(const VulkanMainContext& vmc, UploadContext& upload, const unsigned char* data, uint32_t width, uint32_t height, bool use_mip_maps);
+        // files with the extension .ktx2 are uploaded with the mip levels they contain, use_mip_maps is ignored for them
+        Image(const VulkanMainContext& vmc, UploadContext& upload, const std::string& filename, bool use_mip_maps);
+        // uploads the mip levels of a compressed texture starting at base_mip_level
+        Image(const VulkanMainContext& vmc, UploadContext& upload, const Ktx2Texture& texture, uint32_t base_mip_level);
+        void create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, uint32_t width, uint32_t height, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class);
+        void create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class);
         void create_image_view(vk::Format format, vk::ImageAspectFlags aspects);
         void create_sampler();
         void self_destruct();
-        void transition_image_layout(const VulkanCommandContext& vcc, vk::ImageLayout new_layout, vk::PipelineStageFlags src_stage_flags, vk::PipelineStageFlags dst_stage_flags, vk::AccessFlags src_access_flags, vk::AccessFlags dst_access_flags);
+        // switches to the new image if the defragmentation moved this one and recreates the view, the old view is added to the relocations
+        // may only be called while the device is idle
+        void relocate(Defragmenter::Relocations& relocations);
+        void transition_image_layout(const vk::CommandBuffer& cb, vk::ImageLayout new_layout, vk::PipelineStageFlags src_stage_flags, vk::PipelineStageFlags dst_stage_flags, vk::AccessFlags src_access_flags, vk::AccessFlags dst_access_flags);
         vk::DeviceSize get_byte_size() const;
         vk::Image get_image() const;
         vk::ImageView get_view() const;
@@ -34,10 +42,15 @@ namespace ve
         vk::Image image;
         VmaAllocation vmaa;
         vk::ImageView view;
+        vk::Format view_format;
+        vk::ImageAspectFlags view_aspects;
         vk::Sampler sampler;
 
-        void create_image_from_data(const unsigned char* data, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices);
-        void copy_buffer_to_image(const VulkanCommandContext& vcc, const Buffer& buffer);
-        void generate_mipmaps(const VulkanCommandContext& vcc);
+        void create_image_from_data(const unsigned char* data, UploadContext& upload);
+        void create_image_from_ktx2(const Ktx2Texture& texture, uint32_t base_mip_level, UploadContext& upload);
+        void allocate_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class);
+        void copy_buffer_to_image(const vk::CommandBuffer& cb, const UploadContext::StagingRegion& staging);
+        void copy_buffer_to_image(const vk::CommandBuffer& cb, const UploadContext::StagingRegion& staging, std::vector<vk::BufferImageCopy> copy_regions);
+        void generate_mipmaps(const vk::CommandBuffer& cb);
     };
 }// namespace ve
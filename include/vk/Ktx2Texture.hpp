@@ -0,0 +1,48 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "MappedFile.hpp"
+
+namespace ve
+{
+    // 2D texture in the KTX2 container format with a complete or partial mip chain, supercompression is not supported
+    class Ktx2Texture
+    {
+    public:
+        Ktx2Texture() = default;
+        // maps an existing file, is_valid() is false if it cannot be read or is not supported
+        explicit Ktx2Texture(const std::string& path);
+        // creates the file contents in memory from the data of the mip levels, level 0 is the largest one
+        Ktx2Texture(vk::Format format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels);
+        bool write(const std::string& path) const;
+        bool is_valid() const;
+        vk::Format get_format() const;
+        uint32_t get_width() const;
+        uint32_t get_height() const;
+        uint32_t get_level_count() const;
+        std::span<const unsigned char> get_level(uint32_t level) const;
+
+        // size in bytes of a block of 4x4 texels, 0 for formats that are not supported
+        static uint32_t get_block_size(vk::Format format);
+
+    private:
+        struct Level {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        MappedFile file;
+        std::vector<unsigned char> memory;
+        std::span<const unsigned char> data;
+        vk::Format format = vk::Format::eUndefined;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<Level> levels;
+
+        bool parse();
+    };
+}// namespace ve
@@ -21,8 +21,13 @@ namespace ve
         LogicalDevice(const PhysicalDevice& p_device, QueueFamilyIndices& indices, std::unordered_map<QueueIndex, vk::Queue>& queues);
         void self_destruct();
         const vk::Device& get() const;
+        bool supports_push_descriptors() const;
+        // records vkCmdPushDescriptorSetKHR, which is not exported by the loader and therefore called through its function pointer
+        void push_descriptor_set(const vk::CommandBuffer& cb, vk::PipelineBindPoint bind_point, vk::PipelineLayout layout, uint32_t set, uint32_t write_count, const vk::WriteDescriptorSet* writes) const;
 
     private:
         vk::Device device;
+        // nullptr if VK_KHR_push_descriptor is not enabled
+        PFN_vkCmdPushDescriptorSetKHR cmd_push_descriptor_set = nullptr;
     };
 }// namespace ve
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/LogicalDevice.hpp"
+#include "vk_mem_alloc.h"
+
+namespace ve
+{
+    // kinds of resources with a similar size and lifetime that share memory blocks
+    enum class AllocationClass
+    {
+        // long lived vertex and index buffers
+        Geometry,
+        // sampled images
+        Texture,
+        // small host visible buffers that are rewritten every frame
+        Uniform,
+        // host visible sources of uploads
+        Staging,
+        // render targets that are recreated with the swapchain
+        Attachment
+    };
+
+    constexpr uint32_t allocation_class_count = 5;
+
+    // one VMA pool per allocation class, each with a block size, algorithm and dedicated allocation policy tuned for its resources
+    // resources whose memory requirements do not fit the memory type of their pool are allocated by the default allocator instead
+    class MemoryPools
+    {
+    public:
+        // create info and current handle of a pooled resource, needed to recreate it when the defragmentation moves its allocation
+        struct MovableResource {
+            vk::Buffer buffer;
+            vk::BufferCreateInfo bci;
+            vk::Image image;
+            vk::ImageCreateInfo ici;
+        };
+
+        // resources of one allocation class that are currently alive
+        struct ClassUsage {
+            uint64_t allocation_count = 0;
+            vk::DeviceSize bytes = 0;
+        };
+
+        // usage and budget are only estimates if VK_EXT_memory_budget is not enabled
+        struct HeapBudget {
+            bool device_local = false;
+            // device memory that VMA allocated from the heap and the part of it that is used by allocations
+            vk::DeviceSize block_bytes = 0;
+            vk::DeviceSize allocation_bytes = 0;
+            // memory of the heap used by the whole process and the amount it can use before the driver starts evicting
+            vk::DeviceSize usage = 0;
+            vk::DeviceSize budget = 0;
+        };
+
+        struct Stats {
+            // indexed by AllocationClass
+            std::array<ClassUsage, allocation_class_count> classes{};
+            std::vector<HeapBudget> heaps;
+        };
+
+        MemoryPools(const LogicalDevice& logical_device, VmaAllocator va);
+        // flags can add host access and mapping flags to the ones of the allocation class
+        std::pair<vk::Buffer, VmaAllocation> create_buffer(const vk::BufferCreateInfo& bci, AllocationClass allocation_class, VmaAllocationCreateFlags flags = 0, VmaAllocationInfo* vai = nullptr) const;
+        std::pair<vk::Image, VmaAllocation> create_image(const vk::ImageCreateInfo& ici, AllocationClass allocation_class) const;
+        void destroy_buffer(vk::Buffer buffer, VmaAllocation vmaa) const;
+        void destroy_image(vk::Image image, VmaAllocation vmaa) const;
+        // VK_NULL_HANDLE if the class is not pooled or its pool cannot be defragmented
+        VmaPool get_movable_pool(AllocationClass allocation_class) const;
+        vk::DeviceSize get_block_size(AllocationClass allocation_class) const;
+        std::optional<MovableResource> get_movable_resource(VmaAllocation vmaa) const;
+        // records the handle of a resource that was recreated for a moved allocation
+        void set_movable_handle(VmaAllocation vmaa, vk::Buffer buffer) const;
+        void set_movable_handle(VmaAllocation vmaa, vk::Image image) const;
+        // cheap enough to be queried every frame
+        Stats get_stats() const;
+        // warns about heaps whose usage is close to their budget
+        void log_stats() const;
+        void self_destruct();
+
+    private:
+        const LogicalDevice& logical_device;
+        VmaAllocator va;
+        // VK_NULL_HANDLE for classes that are not pooled
+        std::array<VmaPool, allocation_class_count> pools{};
+        std::array<uint32_t, allocation_class_count> memory_types{};
+        // bookkeeping of the resources created by the pools, it does not change the pools themselves
+        struct AllocationRecord {
+            AllocationClass allocation_class;
+            vk::DeviceSize size;
+            // only set for resources in movable pools
+            std::optional<MovableResource> movable;
+        };
+
+        mutable std::mutex records_mutex;
+        mutable std::unordered_map<VmaAllocation, AllocationRecord> records;
+        mutable std::array<ClassUsage, allocation_class_count> class_usage{};
+
+        // places the allocation in the pool of its class if its size and memory requirements allow it
+        VmaAllocationCreateInfo get_allocation_create_info(AllocationClass allocation_class, const vk::MemoryRequirements& requirements, bool requires_dedicated, VmaAllocationCreateFlags flags) const;
+        void add_record(VmaAllocation vmaa, AllocationClass allocation_class, std::optional<MovableResource> movable) const;
+        void remove_record(VmaAllocation vmaa) const;
+    };
+}// namespace ve
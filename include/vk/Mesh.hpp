@@ -1,5 +1,9 @@
 #pragma once
 
+#include <optional>
+#include <unordered_map>
+
+#include "vk/BindlessTable.hpp"
 #include "vk/DescriptorSetHandler.hpp"
 #include "vk/Image.hpp"
 #include "vk/common.hpp"
@@ -9,14 +13,22 @@ namespace ve
     class Mesh
     {
     public:
-        Mesh(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const Material* material, uint32_t idx_offset, uint32_t idx_count);
+        Mesh(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const Material* material, uint32_t idx_offset, uint32_t idx_count, int32_t vtx_offset, vk::IndexType idx_type);
         void self_destruct();
-        void add_set_bindings(DescriptorSetHandler& dsh);
-        void draw(vk::CommandBuffer& cb, const vk::PipelineLayout layout, const std::vector<vk::DescriptorSet>& sets, uint32_t current_frame);
+        // meshes with the same material share one set, material_sets maps the materials to the sets that were created already
+        // every set gets a texture, meshes without a base texture use fallback_texture
+        void add_material_set(DescriptorSetHandler& material_dsh, std::unordered_map<const Material*, uint32_t>& material_sets, const Image& fallback_texture);
+        void add_material(BindlessTable& bindless_table);
+        // meshes in the bindless table select their material with a push constant, the others bind the set of their material if it is not bound yet
+        void draw(vk::CommandBuffer& cb, const vk::PipelineLayout layout, DescriptorSetHandler& material_dsh);
+        vk::IndexType get_index_type() const;
 
     private:
         uint32_t index_offset, index_count;
-        std::vector<uint32_t> descriptor_set_indices;
+        int32_t vertex_offset;
+        vk::IndexType index_type;
+        std::optional<uint32_t> material_set;
+        std::optional<uint32_t> material_idx;
         const Material* mat;
     };
 }// namespace ve
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+
+#include "vk/Model.hpp"
+
+namespace ve
+{
+    // on-disk cache of the processed geometry of glb files
+    // entries are keyed by a hash of the file content and a hash of the import options, so changing a model file automatically invalidates its entries
+    // a file that is imported with several sets of options has one entry per set
+    class MeshCache
+    {
+    public:
+        static constexpr const char* cache_dir = "../assets/cache/";
+
+        static uint64_t hash(const unsigned char* data, std::size_t size);
+        static bool load(const std::string& path, uint64_t content_hash, uint64_t options_hash, ModelData& model_data);
+        // removes the entries of other versions of the file, the entries of the same file with other options are kept
+        static void store(const std::string& path, uint64_t content_hash, uint64_t options_hash, const ModelData& model_data);
+
+    private:
+        struct Header {
+            char magic[4];
+            uint32_t version;
+            uint64_t content_hash;
+            uint64_t options_hash;
+            VertexFormat vertex_format;
+            uint32_t vertex_size;
+            uint32_t has_textures;
+            float position_offset[3];
+            float position_scale[3];
+            uint32_t padding;
+            uint64_t mesh_count;
+            uint64_t vertex_count;
+            uint64_t index_data_size;
+            uint64_t meshes_offset;
+            uint64_t vertices_offset;
+            uint64_t indices_offset;
+            uint64_t material_count;
+            uint64_t materials_offset;
+        };
+
+        static constexpr uint32_t version = 6;
+
+        static std::string get_cache_prefix(const std::string& path);
+        static std::string get_cache_path(const std::string& path, uint64_t content_hash, uint64_t options_hash);
+    };
+}// namespace ve
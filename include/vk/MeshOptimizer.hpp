@@ -0,0 +1,46 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "vk/Model.hpp"
+
+namespace ve
+{
+    // import time reordering of the geometry to make better use of the post-transform vertex cache and the vertex fetch of the GPU
+    // and optionally to reduce the overdraw within a mesh
+    class MeshOptimizer
+    {
+    public:
+        struct VertexCacheStats {
+            // average cache miss ratio, transformed vertices per triangle (0.5 is optimal for big meshes, 3.0 is the worst case)
+            float acmr;
+            // average transformed to vertex ratio, transformed vertices per unique vertex (1.0 is optimal)
+            float atvr;
+        };
+
+        struct OverdrawStats {
+            uint32_t pixels_covered;
+            uint32_t pixels_shaded;
+            // shaded pixels per covered pixel (1.0 is optimal)
+            float overdraw;
+        };
+
+        static void optimize(ModelData& model_data, const ImportOptions& options);
+        static void optimize_vertex_cache(std::span<uint32_t> indices, uint32_t base_vertex, uint32_t vertex_count);
+        static void optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold);
+        static void optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+        static VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size);
+        static OverdrawStats analyze_overdraw(std::span<const Vertex> vertices, std::span<const uint32_t> indices);
+
+    private:
+        // size of the cache that is simulated to score the vertices while reordering
+        static constexpr uint32_t optimizer_cache_size = 32;
+        // size of the FIFO cache that is used to report statistics, conservative estimate for current hardware
+        static constexpr uint32_t stats_cache_size = 16;
+        // resolution of the grid that the mesh is rasterized to when measuring the overdraw
+        static constexpr uint32_t overdraw_grid_size = 256;
+
+        static uint32_t update_cache(const uint32_t* triangle, uint32_t cache_size, std::vector<uint32_t>& cache_timestamps, uint32_t& timestamp);
+    };
+}// namespace ve
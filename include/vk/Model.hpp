@@ -1,23 +1,140 @@
 #pragma once
 
+#include <array>
+#include <future>
+#include <limits>
+#include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
 #include "tiny_gltf.h"
 
+#include "MappedFile.hpp"
+#include "vk/GeometryHeap.hpp"
+#include "vk/GlbFile.hpp"
 #include "vk/Image.hpp"
+#include "vk/Ktx2Texture.hpp"
 #include "vk/Mesh.hpp"
+#include "vk/TextureCompressor.hpp"
 
 namespace ve
 {
+    // options of the import stages that change the processed geometry, they are therefore part of the mesh cache key
+    struct ImportOptions {
+        // allowed ACMR of the overdraw optimized order relative to the vertex cache optimized order (e.g. 1.05), values below 1.0 disable the overdraw optimization
+        float overdraw_threshold = 0.0f;
+        VertexFormat vertex_format = VertexFormat::Full;
+    };
+
+    // quality budget of the textures of one role, the mip levels above it are never uploaded
+    struct TextureBudget {
+        // largest width or height of the uploaded base level
+        uint32_t max_resolution = std::numeric_limits<uint32_t>::max();
+        // number of mip levels that are always skipped
+        uint32_t mip_bias = 1;
+    };
+
+    // options of the texture import, the compressed textures have their own cache
+    struct TextureImportOptions {
+        // encode the material textures to BC formats, requires device support for BC texture compression
+        bool compress = false;
+        // indexed by TextureRole
+        std::array<TextureBudget, texture_role_count> budgets;
+
+        // first mip level of a texture of the given role and size that is uploaded
+        uint32_t get_base_mip_level(TextureRole role, uint32_t width, uint32_t height) const;
+    };
+
+    // host side result of importing a glb file, does not touch the GPU and can therefore be created on worker threads
+    struct ModelData {
+        struct MeshData {
+            int material_idx;
+            // first index in units of index_type, during the import the offset into the uint32_t indices
+            uint32_t index_offset;
+            uint32_t index_count;
+            // the indices of a mesh are relative to its first vertex after pack_indices
+            int32_t vertex_offset = 0;
+            vk::IndexType index_type = vk::IndexType::eUint32;
+        };
+        // factors of a glTF material, they are part of the mesh cache so that the materials of models without textures can be created without the glTF document
+        struct MaterialFactors {
+            glm::vec4 base_color = glm::vec4(1.0f);
+            glm::vec4 emission = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            float metallic = 1.0f;
+            float roughness = 1.0f;
+        };
+
+        std::string name;
+        tinygltf::Model gltf_model;
+        VertexFormat vertex_format = VertexFormat::Full;
+        // dequantization of the positions of quantized vertices: pos = position_offset + pos_unorm * position_scale
+        glm::vec3 position_offset = glm::vec3(0.0f);
+        glm::vec3 position_scale = glm::vec3(1.0f);
+        std::vector<Vertex> vertices;
+        std::vector<QuantizedVertex> quantized_vertices;
+        std::vector<uint32_t> indices;
+        // indices of the meshes in their index_type, created from indices by pack_indices
+        std::vector<unsigned char> index_data;
+        std::vector<MeshData> meshes;
+        // indexed like gltf_model.materials
+        std::vector<MaterialFactors> material_factors;
+        // models read from the mesh cache keep their geometry in the mapped cache file instead of the vectors above
+        MappedFile cache_file;
+        std::span<const unsigned char> cached_vertex_data;
+        std::span<const unsigned char> cached_index_data;
+        // the glTF document is still needed to create the textures of the materials
+        bool requires_gltf = true;
+        TextureImportOptions texture_options;
+        // indexed like gltf_model.textures, textures without a role are not used by any material
+        std::vector<std::optional<TextureRole>> texture_roles;
+        // compressed versions of the glTF textures, indexed like gltf_model.textures
+        std::vector<std::optional<Ktx2Texture>> compressed_textures;
+        struct DecodedImage {
+            std::vector<unsigned char> pixels;
+            uint32_t width;
+            uint32_t height;
+        };
+        // the glTF document is read in place, the mapping stays alive until the encoded images are decoded
+        std::shared_ptr<const GlbFile> glb_file;
+        // the glTF images are only decoded on demand on a worker pool, both are indexed like gltf_model.images
+        std::vector<std::span<const unsigned char>> encoded_images;
+        std::vector<std::future<DecodedImage>> decoded_images;
+
+        // starts decoding the image in the background if that has not happened yet, the levels above base_mip_level are dropped after decoding
+        void decode_image(int image_idx, uint32_t base_mip_level = 0, bool srgb = false);
+        // waits until the pixels of the image are decoded into gltf_model.images, the size of the image is the size of the decoded base level
+        const tinygltf::Image& wait_for_image(int image_idx);
+
+        // vertices in the layout of vertex_format
+        std::span<const unsigned char> get_vertex_data() const
+        {
+            if (cache_file.is_open()) return cached_vertex_data;
+            if (vertex_format == VertexFormat::Quantized) return std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(quantized_vertices.data()), quantized_vertices.size() * sizeof(QuantizedVertex));
+            return std::span<const unsigned char>(reinterpret_cast<const unsigned char*>(vertices.data()), vertices.size() * sizeof(Vertex));
+        }
+
+        std::span<const unsigned char> get_index_data() const
+        {
+            return cache_file.is_open() ? cached_index_data : std::span<const unsigned char>(index_data);
+        }
+    };
+
     class Model
     {
     public:
-        Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, const std::string& path);
-        Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material);
+        // the geometry is sub-allocated from geometry_heap, which has to outlive the model
+        Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, const std::string& path);
+        Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, ModelData&& model_data);
+        Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material, VertexFormat vertex_format);
+        static ModelData load_model_data(const std::string& path, const ImportOptions& options, const TextureImportOptions& texture_options = TextureImportOptions());
+        static void quantize_vertices(ModelData& model_data);
+        static void pack_indices(ModelData& model_data);
         void self_destruct();
-        void add_set_bindings(DescriptorSetHandler& dsh);
-        void draw(uint32_t current_frame, const vk::PipelineLayout& layout, const std::vector<vk::DescriptorSet>& sets, const glm::mat4& vp);
+        void add_material_sets(DescriptorSetHandler& material_dsh, std::unordered_map<const Material*, uint32_t>& material_sets, const Image& fallback_texture);
+        void add_materials(BindlessTable& bindless_table);
+        void relocate(Defragmenter::Relocations& relocations);
+        void draw(uint32_t current_frame, const vk::PipelineLayout& layout, DescriptorSetHandler& material_dsh, const glm::mat4& vp);
         void translate(const glm::vec3& trans);
         void scale(const glm::vec3& scale);
         void rotate(float degree, const glm::vec3& axis);
@@ -25,20 +142,22 @@ namespace ve
     private:
         const VulkanMainContext& vmc;
         VulkanCommandContext& vcc;
-        std::vector<Vertex> vertices;
-        uint32_t vertex_count = 0;
-        std::vector<uint32_t> indices;
-        Buffer vertex_buffer;
-        Buffer index_buffer;
+        GeometryHeap* geometry_heap;
+        GeometryHeap::Allocation geometry;
         std::vector<Mesh> meshes;
         std::vector<std::optional<Image>> textures;
         std::vector<std::optional<Material>> materials;
         std::string name;
         glm::mat4 transformation;
+        // maps the unorm positions of quantized vertices into model space, identity for the full vertex format
+        glm::mat4 dequantization;
 
-        void load_model(const std::string& path);
-        Material* load_material(int mat_idx, const tinygltf::Model& model);
-        void process_node(const tinygltf::Node& node, const tinygltf::Model& model, const glm::mat4 trans);
-        void process_mesh(const tinygltf::Mesh& mesh, const tinygltf::Model& model, const glm::mat4 matrix);
+        void upload_model_data(ModelData& model_data, UploadContext& upload);
+        void upload_geometry(const ModelData& model_data, UploadContext& upload);
+        // the offsets of the mesh are moved into the geometry of the model
+        void add_mesh(const ModelData::MeshData& mesh_data, const Material* material);
+        Material* load_material(int mat_idx, ModelData& model_data, UploadContext& upload);
+        static void process_node(const tinygltf::Node& node, const tinygltf::Model& model, const glm::mat4 trans, ModelData& model_data);
+        static void process_mesh(const tinygltf::Mesh& mesh, const tinygltf::Model& model, const glm::mat4 matrix, ModelData& model_data);
     };
 }// namespace ve
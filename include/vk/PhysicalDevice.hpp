@@ -25,6 +25,9 @@ namespace ve
         QueueFamilyIndices get_queue_families() const;
         const std::vector<const char*>& get_extensions() const;
         const std::vector<const char*>& get_missing_extensions();
+        bool is_extension_enabled(const char* extension) const;
+        // features of descriptor indexing that are needed for bindless textures
+        bool supports_descriptor_indexing() const;
 
     private:
         vk::PhysicalDevice physical_device;
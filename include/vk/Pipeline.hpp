@@ -5,6 +5,7 @@
 #include "vk/DescriptorSetHandler.hpp"
 #include "vk/RenderPass.hpp"
 #include "vk/VulkanMainContext.hpp"
+#include "vk/common.hpp"
 
 namespace ve
 {
@@ -13,7 +14,7 @@ namespace ve
     public:
         Pipeline(const VulkanMainContext& vmc);
         void self_destruct();
-        void construct(const RenderPass& render_pass, vk::DescriptorSetLayout set_layout, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode);
+        void construct(const RenderPass& render_pass, const std::vector<vk::DescriptorSetLayout>& set_layouts, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode, VertexFormat vertex_format);
         const vk::Pipeline& get() const;
         const vk::PipelineLayout& get_layout() const;
 
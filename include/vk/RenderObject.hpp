@@ -13,18 +13,42 @@ namespace ve
     public:
         RenderObject(const VulkanMainContext& vmc);
         void self_destruct();
-        uint32_t add_model(VulkanCommandContext& vcc, const std::string& path);
-        uint32_t add_model(VulkanCommandContext& vcc, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material);
+        uint32_t add_model(VulkanCommandContext& vcc, UploadContext& upload, const std::string& path);
+        uint32_t add_model(VulkanCommandContext& vcc, UploadContext& upload, ModelData&& model_data);
+        uint32_t add_model(VulkanCommandContext& vcc, UploadContext& upload, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material);
+        // ticket of the upload batch that contains the last added model
+        UploadTicket get_upload_ticket() const;
         Model* get_model(uint32_t idx);
+        // the vertex format can only be changed as long as the render object contains no models
+        void set_vertex_format(VertexFormat format);
+        VertexFormat get_vertex_format() const;
+        // in bindless mode the table is the material set, it has to outlive the render object
+        void set_bindless_table(BindlessTable* table);
+        // used by the material sets of meshes without a base texture, it has to outlive the render object
+        void set_fallback_texture(const Image* texture);
+        // adds the frame set of the next frame in flight with the descriptors that are applied to new sets of frame_dsh
         void add_bindings();
+        void add_materials(BindlessTable& bindless_table);
+        // the images of the models are relocated before the descriptor sets that refer to them
+        void relocate(Defragmenter::Relocations& relocations);
+        // creates one material set per distinct material of the models unless the bindless table is used
         void construct(const RenderPass& render_pass, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode);
         void draw(vk::CommandBuffer& cb, uint32_t current_frame, const glm::mat4& vp);
 
-        DescriptorSetHandler dsh;
+        // set 0, one set per frame in flight
+        DescriptorSetHandler frame_dsh;
+        // set 1, shared by all meshes with the same material
+        DescriptorSetHandler material_dsh;
 
     private:
         const VulkanMainContext& vmc;
+        // all models share one vertex format, so their geometry lives in one heap
+        GeometryHeap geometry_heap;
         std::vector<Model> models;
         Pipeline pipeline;
+        VertexFormat vertex_format;
+        UploadTicket upload_ticket;
+        BindlessTable* bindless_table = nullptr;
+        const Image* fallback_texture = nullptr;
     };
 }// namespace ve
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "common.hpp"
+#include "vk/BindlessTable.hpp"
+#include "vk/Defragmenter.hpp"
 #include "vk/Model.hpp"
 #include "vk/RenderObject.hpp"
 
@@ -9,24 +11,41 @@ namespace ve
     class Scene
     {
     public:
-        Scene(const VulkanMainContext& vmc, VulkanCommandContext& vcc);
+        Scene(const VulkanMainContext& vmc, VulkanCommandContext& vcc, uint32_t frames_in_flight);
         void construct(const RenderPass& render_pass);
         void self_destruct();
-        void load(const std::string& path);
+        void load(const std::string& path, bool parallel = true);
+        // the uploads are recorded asynchronously, draw() acquires them before the models are used for the first time
         void add_model(const std::string& key, ModelHandle model_handle);
+        void add_model(const std::string& key, ModelHandle model_handle, ModelData&& model_data);
+        // starts the transfers of all models that were added since the last call
+        UploadTicket submit_uploads();
         void add_bindings();
         void translate(const std::string& model, const glm::vec3& trans);
         void scale(const std::string& model, const glm::vec3& scale);
         void rotate(const std::string& model, float degree, const glm::vec3& axis);
+        // handler of the per frame sets
         DescriptorSetHandler& get_dsh(ShaderFlavor flavor);
+        // advances the defragmentation of the textures and geometry, has to be called once per frame before the frame is recorded
+        void update_defragmentation();
         void draw(vk::CommandBuffer& cb, uint32_t current_frame, const glm::mat4& vp);
 
     private:
         const VulkanMainContext& vmc;
         VulkanCommandContext& vcc;
+        UploadContext upload;
+        Defragmenter defragmenter;
+        // only set if the device supports descriptor indexing, the default render object then draws with bindless materials
+        std::optional<BindlessTable> bindless_table;
+        // 1x1 white texture for the material sets of meshes without a base texture, only needed without the bindless table
+        std::optional<Image> fallback_texture;
         std::unordered_map<ShaderFlavor, RenderObject> ros;
         std::unordered_map<std::string, ModelHandle> model_handles;
         std::vector<Image> images;
         std::vector<Material> materials;
+
+        // new uploads may write to resources that are moved, so the current pass is finished first
+        void finish_defragmentation();
+        void relocate(Defragmenter::Relocations& relocations);
     };
 }// namespace ve
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <optional>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/VulkanMainContext.hpp"
+
+namespace ve
+{
+    // persistently mapped host visible buffer that staging data is sub-allocated from in a ring
+    // allocations are grouped into submissions, their memory is reused as soon as the submission is released
+    class StagingRing
+    {
+    public:
+        struct Allocation {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+            unsigned char* mapped;
+        };
+
+        StagingRing(const VulkanMainContext& vmc, vk::DeviceSize size);
+        // no value if the ring is too full until older submissions are released
+        std::optional<Allocation> allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+        // makes host writes to an allocation visible to the device
+        void flush(const Allocation& allocation, vk::DeviceSize size) const;
+        // groups all allocations since the last call into a submission that is identified by value, values have to increase
+        void submit(uint64_t value);
+        // reuses the memory of all submissions with a value <= completed_value, e.g. the counter of the timeline semaphore they signal
+        void release(uint64_t completed_value);
+        vk::DeviceSize get_size() const;
+        void self_destruct();
+
+    private:
+        const VulkanMainContext& vmc;
+        vk::DeviceSize size;
+        vk::Buffer buffer;
+        VmaAllocation vmaa;
+        unsigned char* mapped;
+        // positions are increasing and wrap around at size, everything between tail and head is in use
+        uint64_t head = 0;
+        uint64_t tail = 0;
+        // value and end position of submissions that are not released yet
+        std::deque<std::pair<uint64_t, uint64_t>> submissions;
+    };
+}// namespace ve
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <optional>
+#include <vulkan/vulkan.hpp>
+
+#include "tiny_gltf.h"
+
+#include "vk/Ktx2Texture.hpp"
+#include "vk/VulkanMainContext.hpp"
+
+namespace ve
+{
+    struct ModelData;
+
+    // usage of a texture in a material, decides about the compressed format
+    enum class TextureRole
+    {
+        BaseColor,
+        MetallicRoughness,
+        Normal,
+        Emissive,
+        Occlusion
+    };
+
+    constexpr uint32_t texture_role_count = 5;
+
+    // import time encoder for BC1/BC3/BC5/BC7 compressed textures with complete mip chains
+    // the results are cached as KTX2 files keyed by the hash of the texture content and the format
+    class TextureCompressor
+    {
+    public:
+        static bool is_supported(const VulkanMainContext& vmc);
+        static vk::Format get_format(TextureRole role, bool has_alpha);
+        static Ktx2Texture compress(const unsigned char* rgba, uint32_t width, uint32_t height, vk::Format format);
+        // role of every texture of the model in the first material that uses it, indexed like model.textures
+        static std::vector<std::optional<TextureRole>> get_texture_roles(const tinygltf::Model& model);
+        static bool is_srgb(TextureRole role);
+        // halves the size of an RGBA8 image with a box filter
+        static std::vector<unsigned char> downsample(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height, bool srgb);
+        // compresses or loads from the cache all textures that are used by the materials of the model
+        static void compress_textures(ModelData& model_data);
+
+        static void encode_bc1_block(const unsigned char* rgba, unsigned char* block);
+        static void encode_bc3_block(const unsigned char* rgba, unsigned char* block);
+        static void encode_bc5_block(const unsigned char* rgba, unsigned char* block);
+        static void encode_bc7_block(const unsigned char* rgba, unsigned char* block);
+
+    private:
+        static void encode_bc1_color(const unsigned char* rgba, unsigned char* block);
+        static void encode_bc4_channel(const unsigned char* rgba, uint32_t channel, unsigned char* block);
+    };
+}// namespace ve
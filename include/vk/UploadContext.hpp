@@ -0,0 +1,90 @@
+#pragma once
+
+#include <deque>
+#include <vulkan/vulkan.hpp>
+
+#include "vk/VulkanCommandContext.hpp"
+#include "vk_mem_alloc.h"
+
+namespace ve
+{
+    // identifies an upload batch, the batches of an UploadContext are numbered in submission order
+    struct UploadTicket {
+        uint64_t value = 0;
+    };
+
+    // records uploads into batches that are executed asynchronously on the transfer queue
+    // copies and the transitions before them are recorded on the transfer queue, mip generation and the transitions for shader access on the graphics queue
+    // the graphics commands of a batch are only submitted by acquire(), i.e. right before the first graphics submit that uses its resources
+    // uploaded resources are exclusively owned by the graphics queue family, the transfer queue hands them over with ownership transfers
+    class UploadContext
+    {
+    public:
+        // location of staged data that can be used as the source of copy commands
+        struct StagingRegion {
+            vk::Buffer buffer;
+            vk::DeviceSize offset;
+        };
+
+        UploadContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc);
+        // copies data into staging memory that lives until the transfers of the batch are finished
+        // may submit the batch first and wait for its transfers if the staging memory is exhausted
+        StagingRegion stage(const void* data, vk::DeviceSize size);
+        // the range is handed over to the graphics queue family after the copy
+        void copy_to_buffer(const void* data, vk::DeviceSize size, vk::Buffer dst_buffer, vk::DeviceSize dst_offset);
+        // records the release on the transfer queue and the acquire on the graphics queue if they belong to different families
+        // the image keeps its layout, the graphics commands recorded afterwards can continue with transfer commands
+        void transfer_ownership(vk::Image image, vk::ImageLayout layout, uint32_t mip_levels);
+        const vk::CommandBuffer& get_transfer_cb();
+        const vk::CommandBuffer& get_graphics_cb();
+        // ticket of the batch that is currently recorded
+        UploadTicket get_ticket() const;
+        // submits the recorded transfer commands without waiting for them
+        UploadTicket submit();
+        // submits the graphics commands of all batches up to ticket to the graphics queue where they wait for the transfers
+        // graphics submits made afterwards can use the resources of those batches without any further synchronization
+        void acquire(UploadTicket ticket);
+        bool is_finished(UploadTicket ticket) const;
+        // true if nothing is recorded and all submitted batches are acquired and finished
+        bool is_idle() const;
+        // submits and acquires all recorded uploads and waits for their completion
+        void flush();
+        void self_destruct();
+
+    private:
+        struct Batch {
+            vk::CommandBuffer transfer_cb;
+            vk::CommandBuffer graphics_cb;
+            // signalled on both timelines when the commands of the batch are finished
+            uint64_t value;
+            // uploads that are too large for the staging ring of vcc
+            std::vector<std::pair<vk::Buffer, VmaAllocation>> dedicated_buffers;
+            vk::DeviceSize dedicated_size = 0;
+        };
+
+        // satisfies the offset requirements of buffer to image copies for all used formats
+        static constexpr vk::DeviceSize staging_alignment = 16;
+        // dedicated staging buffers of a batch are limited as well, large scenes are therefore uploaded in several batches
+        static constexpr vk::DeviceSize max_dedicated_size = 256 * 1024 * 1024;
+
+        const VulkanMainContext& vmc;
+        VulkanCommandContext& vcc;
+        vk::Semaphore transfer_timeline;
+        vk::Semaphore graphics_timeline;
+        Batch recording;
+        bool recorded = false;
+        uint64_t submitted_value = 0;
+        // batches whose graphics commands are not acquired yet
+        std::deque<Batch> pending;
+        // batches whose graphics commands are submitted
+        std::deque<Batch> in_flight;
+        // finished batches whose command buffers can be reused
+        std::vector<Batch> finished;
+
+        StagingRegion stage_dedicated(const void* data, vk::DeviceSize size);
+        void begin_batch(uint64_t value);
+        // releases the staging memory of finished transfers and recycles finished batches
+        void reclaim();
+        void wait(const vk::Semaphore& timeline, uint64_t value) const;
+    };
+}// namespace ve
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include "vk/common.hpp"
+
+namespace ve
+{
+    // conversion of whole glTF attribute streams into vertices, uses AVX2 or SSE for the positions and normals if available
+    class VertexConversion
+    {
+    public:
+        // float attribute data with the distance between two consecutive elements in floats
+        struct AttributeStream {
+            const float* data = nullptr;
+            std::size_t stride = 0;
+        };
+
+        static void transform_positions(AttributeStream positions, std::size_t count, const glm::mat4& matrix, Vertex* vertices);
+        static void normalize_normals(AttributeStream normals, std::size_t count, Vertex* vertices);
+        // colors with three components get an alpha of 1.0, vertices without color stream get the default color
+        static void copy_colors(AttributeStream colors, uint32_t component_count, std::size_t count, const glm::vec4& default_color, Vertex* vertices);
+        static void copy_tex_coords(AttributeStream tex_coords, std::size_t count, Vertex* vertices);
+    };
+}// namespace ve
@@ -4,6 +4,7 @@
 
 #include "vk/Synchronization.hpp"
 #include "vk/CommandPool.hpp"
+#include "vk/StagingRing.hpp"
 #include "vk/VulkanMainContext.hpp"
 
 namespace ve
@@ -27,8 +28,12 @@ namespace ve
         std::vector<vk::CommandBuffer> graphics_cb;
         std::vector<vk::CommandBuffer> compute_cb;
         std::vector<vk::CommandBuffer> transfer_cb;
+        // shared staging memory of all uploads
+        StagingRing staging_ring;
 
     private:
+        static constexpr vk::DeviceSize staging_ring_size = 64 * 1024 * 1024;
+
         void submit(const vk::CommandBuffer& cb, const vk::Queue& queue, bool wait_idle) const;
     };
 }// namespace ve
@@ -4,7 +4,9 @@
 #include <vulkan/vulkan.hpp>
 
 #include "Window.hpp"
+#include "vk/DescriptorSetLayoutCache.hpp"
 #include "vk/LogicalDevice.hpp"
+#include "vk/MemoryPools.hpp"
 #include "vk/PhysicalDevice.hpp"
 #include "vk_mem_alloc.h"
 
@@ -27,7 +29,7 @@ namespace ve
     private:
         std::unordered_map<QueueIndex, vk::Queue> queues;
 
-        void create_vma_allocator();
+        VmaAllocator create_vma_allocator() const;
 
     public:
         QueueFamilyIndices queues_family_indices;
@@ -37,5 +39,7 @@ namespace ve
         PhysicalDevice physical_device;
         LogicalDevice logical_device;
         VmaAllocator va;
+        MemoryPools memory_pools;
+        DescriptorSetLayoutCache descriptor_set_layouts;
     };
 }// namespace ve
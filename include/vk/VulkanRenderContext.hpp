@@ -54,7 +54,11 @@ namespace ve
         vk::Extent2D recreate_swapchain();
 
     private:
+        // seconds between two logs of the memory usage
+        static constexpr float memory_log_interval = 60.0f;
+
         float total_time = 0.0f;
+        float next_memory_log = memory_log_interval;
 
         void record_graphics_command_buffer(uint32_t image_idx, const glm::mat4& vp);
         void submit_graphics(uint32_t image_idx);
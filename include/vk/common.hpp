@@ -13,8 +13,29 @@ namespace ve
         Default
     };
 
+    // indices of the descriptor sets in the pipeline layouts, the sets are split by how often their descriptors change
+    enum class DescriptorSetFrequency
+    {
+        // bound once per frame, e.g. the camera uniform buffer
+        PerFrame = 0,
+        // shared by all meshes with the same material, or the bindless material table
+        PerMaterial = 1,
+        // reserved for descriptors that change with every draw, the current draw data fits into the push constants
+        PerDraw = 2
+    };
+
+    enum class VertexFormat
+    {
+        // Vertex with 32 bit floats for every attribute
+        Full,
+        // QuantizedVertex with positions relative to the model bounding box, octahedral normals, unorm8 color and half float uvs
+        Quantized
+    };
+
     struct PushConstants {
         glm::mat4 MVP;
+        // index into the material table, only used by the bindless pipelines
+        uint32_t material_idx;
     };
 
     struct Vertex {
@@ -47,7 +68,7 @@ namespace ve
 
             attribute_descriptions[2].binding = 0;
             attribute_descriptions[2].location = 2;
-            attribute_descriptions[2].format = vk::Format::eR32G32B32Sfloat;
+            attribute_descriptions[2].format = vk::Format::eR32G32B32A32Sfloat;
             attribute_descriptions[2].offset = offsetof(Vertex, color);
 
             attribute_descriptions[3].binding = 0;
@@ -59,13 +80,66 @@ namespace ve
         }
     };
 
+    // 20 byte alternative to Vertex, the pipelines decode it in default.vert
+    struct QuantizedVertex {
+        // unorm16 position inside the bounding box of the model, the fourth component is padding
+        uint16_t pos[4];
+        // octahedral encoded normal as snorm16x2
+        uint32_t normal;
+        // unorm8x4
+        uint32_t color;
+        // half float x2
+        uint32_t tex;
+
+        static vk::VertexInputBindingDescription get_binding_description()
+        {
+            vk::VertexInputBindingDescription binding_description{};
+            binding_description.binding = 0;
+            binding_description.stride = sizeof(QuantizedVertex);
+            binding_description.inputRate = vk::VertexInputRate::eVertex;
+            return binding_description;
+        }
+
+        static std::array<vk::VertexInputAttributeDescription, 4> get_attribute_descriptions()
+        {
+            std::array<vk::VertexInputAttributeDescription, 4> attribute_descriptions{};
+            attribute_descriptions[0].binding = 0;
+            attribute_descriptions[0].location = 0;
+            attribute_descriptions[0].format = vk::Format::eR16G16B16A16Unorm;
+            attribute_descriptions[0].offset = offsetof(QuantizedVertex, pos);
+
+            attribute_descriptions[1].binding = 0;
+            attribute_descriptions[1].location = 1;
+            attribute_descriptions[1].format = vk::Format::eR16G16Snorm;
+            attribute_descriptions[1].offset = offsetof(QuantizedVertex, normal);
+
+            attribute_descriptions[2].binding = 0;
+            attribute_descriptions[2].location = 2;
+            attribute_descriptions[2].format = vk::Format::eR8G8B8A8Unorm;
+            attribute_descriptions[2].offset = offsetof(QuantizedVertex, color);
+
+            attribute_descriptions[3].binding = 0;
+            attribute_descriptions[3].location = 3;
+            attribute_descriptions[3].format = vk::Format::eR16G16Sfloat;
+            attribute_descriptions[3].offset = offsetof(QuantizedVertex, tex);
+
+            return attribute_descriptions;
+        }
+    };
+
+    inline uint32_t get_vertex_size(VertexFormat format)
+    {
+        return format == VertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+    }
+
     class Image;
 
     struct Material {
         float metallic = 1.0f;
         float roughness = 1.0f;
         glm::vec4 base_color = glm::vec4(1.0f);
-        glm::vec4 emission = glm::vec4(1.0f);
+        // glTF materials without an emissive factor do not emit light
+        glm::vec4 emission = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
         Image* base_texture;
         Image* metallic_roughness_texture;
         Image* normal_texture;
@@ -73,6 +147,24 @@ namespace ve
         Image* emissive_texture;
     };
 
+    // std430 layout of a material in the material table of the bindless pipelines, mirrored in bindless.frag
+    struct ShaderMaterial {
+        // textures that are not set use this index
+        static constexpr uint32_t no_texture = 0xFFFFFFFF;
+
+        glm::vec4 base_color;
+        glm::vec4 emission;
+        float metallic;
+        float roughness;
+        // indices into the texture array
+        uint32_t base_texture;
+        uint32_t metallic_roughness_texture;
+        uint32_t normal_texture;
+        uint32_t occlusion_texture;
+        uint32_t emissive_texture;
+        uint32_t padding;
+    };
+
     struct ModelHandle {
         ModelHandle(ShaderFlavor flavor, const std::string& file) : shader_flavor(flavor), idx(0), filename(file)
         {}
@@ -0,0 +1,47 @@
+#version 460
+
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 frag_normal;
+layout(location = 1) in vec3 frag_color;
+layout(location = 2) in vec2 frag_tex;
+
+layout(location = 0) out vec4 out_color;
+
+// mirrors ShaderMaterial, textures that are not set have the index NO_TEXTURE
+struct Material
+{
+    vec4 base_color;
+    vec4 emission;
+    float metallic;
+    float roughness;
+    uint base_texture;
+    uint metallic_roughness_texture;
+    uint normal_texture;
+    uint occlusion_texture;
+    uint emissive_texture;
+    uint padding;
+};
+
+const uint NO_TEXTURE = 0xFFFFFFFF;
+
+layout(set = 1, binding = 0) readonly buffer MaterialTable {
+    Material materials[];
+};
+
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+layout(push_constant) uniform PushConstants
+{
+    layout(offset = 64) uint material_idx;
+} pc;
+
+void main()
+{
+    Material material = materials[pc.material_idx];
+    vec4 base_color = material.base_color;
+    if (material.base_texture != NO_TEXTURE) base_color *= texture(textures[material.base_texture], frag_tex);
+    vec3 emission = material.emission.rgb;
+    if (material.emissive_texture != NO_TEXTURE) emission *= texture(textures[material.emissive_texture], frag_tex).rgb;
+    out_color = max(0.01, dot(vec3(1.0, 1.0, -1.0), frag_normal)) * base_color + vec4(emission, 0.0);
+}
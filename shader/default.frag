@@ -6,7 +6,7 @@ layout(location = 2) in vec2 frag_tex;
 
 layout(location = 0) out vec4 out_color;
 
-layout(binding = 1) uniform sampler2D tex_sampler;
+layout(set = 1, binding = 0) uniform sampler2D tex_sampler;
 
 void main()
 {
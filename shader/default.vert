@@ -1,5 +1,8 @@
 #version 460
 
+// set for quantized vertices: unorm16 positions, octahedral snorm16 normals, unorm8 colors and half float texture coordinates
+layout(constant_id = 0) const bool QUANTIZED_VERTICES = false;
+
 layout(location = 0) in vec3 pos;
 layout(location = 1) in vec3 normal;
 layout(location = 2) in vec3 color;
@@ -9,18 +12,27 @@ layout(location = 0) out vec3 frag_normal;
 layout(location = 1) out vec3 frag_color;
 layout(location = 2) out vec2 frag_tex;
 
-layout(binding = 0) uniform UniformBufferObject {
+layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 VP;
 } ubo;
 
+// the dequantization of quantized positions is already contained in the MVP matrix
 layout(push_constant) uniform PushConstants
 {
     mat4 MVP;
 } pc;
 
+vec3 decode_octahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main() {
     gl_Position = pc.MVP * vec4(pos, 1.0);
-    frag_normal = (vec4(normal, 1.0)).rgb;
+    vec3 n = QUANTIZED_VERTICES ? decode_octahedral(normal.xy) : normal;
+    frag_normal = (vec4(n, 1.0)).rgb;
     frag_color = color;
     frag_tex = tex;
 }
@@ -0,0 +1,102 @@
+#include "MappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER file_size;
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (view)
+            {
+                mapped_data = static_cast<const unsigned char*>(view);
+                byte_size = file_size.QuadPart;
+            }
+            // the view keeps the mapping object alive
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            mapped_data = static_cast<const unsigned char*>(mapping);
+            byte_size = file_stat.st_size;
+        }
+    }
+    // the mapping stays valid after closing the file descriptor
+    close(fd);
+}
+#endif
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : mapped_data(std::exchange(other.mapped_data, nullptr)), byte_size(std::exchange(other.byte_size, 0))
+{}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        mapped_data = std::exchange(other.mapped_data, nullptr);
+        byte_size = std::exchange(other.byte_size, 0);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+bool MappedFile::is_open() const
+{
+    return mapped_data != nullptr;
+}
+
+const unsigned char* MappedFile::data() const
+{
+    return mapped_data;
+}
+
+std::size_t MappedFile::size() const
+{
+    return byte_size;
+}
+
+void MappedFile::unmap()
+{
+#ifdef _WIN32
+    if (mapped_data) UnmapViewOfFile(mapped_data);
+#else
+    if (mapped_data) munmap(const_cast<unsigned char*>(mapped_data), byte_size);
+#endif
+    mapped_data = nullptr;
+    byte_size = 0;
+}
@@ -33,8 +33,8 @@ public:
 
     ~MainContext()
     {
-        vcc.self_destruct();
         vrc.self_destruct();
+        vcc.self_destruct();
         vmc.self_destruct();
         VE_LOG_CONSOLE(VE_INFO, VE_C_PINK << "Destroyed MainContext" << std::endl);
     }
@@ -0,0 +1,173 @@
+#include "vk/BindlessTable.hpp"
+
+#include <algorithm>
+
+namespace ve
+{
+    BindlessTable::BindlessTable(const VulkanMainContext& vmc) : vmc(vmc)
+    {
+        const auto properties = vmc.physical_device.get().getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>().get<vk::PhysicalDeviceVulkan12Properties>();
+        // combined image samplers count against the limits of samplers and sampled images
+        texture_capacity = std::min({max_textures, properties.maxPerStageDescriptorUpdateAfterBindSamplers, properties.maxPerStageDescriptorUpdateAfterBindSampledImages, properties.maxDescriptorSetUpdateAfterBindSamplers, properties.maxDescriptorSetUpdateAfterBindSampledImages});
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings(2);
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = vk::ShaderStageFlagBits::eFragment;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        bindings[1].descriptorCount = texture_capacity;
+        bindings[1].stageFlags = vk::ShaderStageFlagBits::eFragment;
+        // the array is only as large as the number of textures of the scene
+        const std::vector<vk::DescriptorBindingFlags> binding_flags = {{}, vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind | vk::DescriptorBindingFlagBits::eVariableDescriptorCount};
+        layout = vmc.descriptor_set_layouts.get(bindings, vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool, binding_flags);
+
+        // the default material is used by meshes without a material
+        ShaderMaterial default_material{};
+        default_material.base_color = glm::vec4(1.0f);
+        default_material.emission = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        default_material.metallic = 1.0f;
+        default_material.roughness = 1.0f;
+        default_material.base_texture = ShaderMaterial::no_texture;
+        default_material.metallic_roughness_texture = ShaderMaterial::no_texture;
+        default_material.normal_texture = ShaderMaterial::no_texture;
+        default_material.occlusion_texture = ShaderMaterial::no_texture;
+        default_material.emissive_texture = ShaderMaterial::no_texture;
+        materials.push_back(default_material);
+        material_indices.emplace(nullptr, 0);
+    }
+
+    bool BindlessTable::is_supported(const VulkanMainContext& vmc)
+    {
+        return vmc.physical_device.supports_descriptor_indexing();
+    }
+
+    uint32_t BindlessTable::add_material(const Material* material)
+    {
+        auto it = material_indices.find(material);
+        if (it != material_indices.end()) return it->second;
+        ShaderMaterial shader_material{};
+        shader_material.base_color = material->base_color;
+        shader_material.emission = material->emission;
+        shader_material.metallic = material->metallic;
+        shader_material.roughness = material->roughness;
+        shader_material.base_texture = add_texture(material->base_texture);
+        shader_material.metallic_roughness_texture = add_texture(material->metallic_roughness_texture);
+        shader_material.normal_texture = add_texture(material->normal_texture);
+        shader_material.occlusion_texture = add_texture(material->occlusion_texture);
+        shader_material.emissive_texture = add_texture(material->emissive_texture);
+        materials.push_back(shader_material);
+        material_indices.emplace(material, materials.size() - 1);
+        return materials.size() - 1;
+    }
+
+    void BindlessTable::construct()
+    {
+        material_buffer = Buffer(vmc, materials, vk::BufferUsageFlagBits::eStorageBuffer, {uint32_t(vmc.queues_family_indices.graphics)}, AllocationClass::Uniform);
+
+        // the pool of a set with update after bind bindings needs the same flag
+        const std::vector<vk::DescriptorPoolSize> pool_sizes = {{vk::DescriptorType::eStorageBuffer, 1}, {vk::DescriptorType::eCombinedImageSampler, std::max(1u, uint32_t(textures.size()))}};
+        vk::DescriptorPoolCreateInfo dpci{};
+        dpci.sType = vk::StructureType::eDescriptorPoolCreateInfo;
+        dpci.flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+        dpci.poolSizeCount = pool_sizes.size();
+        dpci.pPoolSizes = pool_sizes.data();
+        dpci.maxSets = 1;
+        pool = vmc.logical_device.get().createDescriptorPool(dpci);
+
+        const uint32_t texture_count = textures.size();
+        vk::DescriptorSetVariableDescriptorCountAllocateInfo dsvdcai{};
+        dsvdcai.sType = vk::StructureType::eDescriptorSetVariableDescriptorCountAllocateInfo;
+        dsvdcai.descriptorSetCount = 1;
+        dsvdcai.pDescriptorCounts = &texture_count;
+        vk::DescriptorSetAllocateInfo dsai{};
+        dsai.sType = vk::StructureType::eDescriptorSetAllocateInfo;
+        dsai.pNext = &dsvdcai;
+        dsai.descriptorPool = pool;
+        dsai.descriptorSetCount = 1;
+        dsai.pSetLayouts = &layout;
+        set = vmc.logical_device.get().allocateDescriptorSets(dsai)[0];
+
+        vk::DescriptorBufferInfo dbi{};
+        dbi.buffer = material_buffer.get();
+        dbi.offset = 0;
+        dbi.range = material_buffer.get_byte_size();
+        std::vector<vk::WriteDescriptorSet> wds_s(1);
+        wds_s[0].sType = vk::StructureType::eWriteDescriptorSet;
+        wds_s[0].dstSet = set;
+        wds_s[0].dstBinding = 0;
+        wds_s[0].dstArrayElement = 0;
+        wds_s[0].descriptorType = vk::DescriptorType::eStorageBuffer;
+        wds_s[0].descriptorCount = 1;
+        wds_s[0].pBufferInfo = &dbi;
+        if (!textures.empty())
+        {
+            vk::WriteDescriptorSet wds{};
+            wds.sType = vk::StructureType::eWriteDescriptorSet;
+            wds.dstSet = set;
+            wds.dstBinding = 1;
+            wds.dstArrayElement = 0;
+            wds.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+            wds.descriptorCount = textures.size();
+            wds.pImageInfo = textures.data();
+            wds_s.push_back(wds);
+        }
+        vmc.logical_device.get().updateDescriptorSets(wds_s, {});
+        VE_LOG_CONSOLE(VE_INFO, "Created bindless table with " << materials.size() << " materials and " << textures.size() << " textures\n");
+    }
+
+    void BindlessTable::relocate(const Defragmenter::Relocations& relocations)
+    {
+        std::vector<vk::WriteDescriptorSet> wds_s;
+        for (uint32_t i = 0; i < textures.size(); ++i)
+        {
+            auto it = relocations.image_views.find(textures[i].imageView);
+            if (it == relocations.image_views.end()) continue;
+            textures[i].imageView = it->second;
+            vk::WriteDescriptorSet wds{};
+            wds.sType = vk::StructureType::eWriteDescriptorSet;
+            wds.dstSet = set;
+            wds.dstBinding = 1;
+            wds.dstArrayElement = i;
+            wds.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+            wds.descriptorCount = 1;
+            wds.pImageInfo = &textures[i];
+            wds_s.push_back(wds);
+        }
+        if (!wds_s.empty()) vmc.logical_device.get().updateDescriptorSets(wds_s, {});
+    }
+
+    void BindlessTable::self_destruct()
+    {
+        if (!pool) return;
+        vmc.logical_device.get().destroyDescriptorPool(pool);
+        pool = vk::DescriptorPool();
+        material_buffer.self_destruct();
+    }
+
+    vk::DescriptorSetLayout BindlessTable::get_layout() const
+    {
+        return layout;
+    }
+
+    vk::DescriptorSet BindlessTable::get_set() const
+    {
+        return set;
+    }
+
+    uint32_t BindlessTable::add_texture(const Image* image)
+    {
+        if (image == nullptr) return ShaderMaterial::no_texture;
+        auto it = texture_indices.find(image);
+        if (it != texture_indices.end()) return it->second;
+        VE_ASSERT(textures.size() < texture_capacity, "Too many textures for the bindless texture array!\n");
+        vk::DescriptorImageInfo dii{};
+        dii.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        dii.imageView = image->get_view();
+        dii.sampler = image->get_sampler();
+        textures.push_back(dii);
+        texture_indices.emplace(image, textures.size() - 1);
+        return textures.size() - 1;
+    }
+}// namespace ve
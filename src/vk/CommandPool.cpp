@@ -26,6 +26,11 @@ namespace ve
         return device.allocateCommandBuffers(cbai);
     }
 
+    void CommandPool::free_command_buffers(const std::vector<vk::CommandBuffer>& command_buffers)
+    {
+        device.freeCommandBuffers(command_pool, command_buffers);
+    }
+
     void CommandPool::self_destruct()
     {
         device.destroyCommandPool(command_pool);
@@ -0,0 +1,260 @@
+#include "vk/Defragmenter.hpp"
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        constexpr vk::DeviceSize mib = 1024 * 1024;
+
+        vk::ImageMemoryBarrier image_barrier(vk::Image image, uint32_t mip_levels, vk::ImageLayout old_layout, vk::ImageLayout new_layout, vk::AccessFlags src_access_flags, vk::AccessFlags dst_access_flags)
+        {
+            vk::ImageMemoryBarrier imb{};
+            imb.sType = vk::StructureType::eImageMemoryBarrier;
+            imb.oldLayout = old_layout;
+            imb.newLayout = new_layout;
+            imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imb.image = image;
+            imb.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+            imb.subresourceRange.baseMipLevel = 0;
+            imb.subresourceRange.levelCount = mip_levels;
+            imb.subresourceRange.baseArrayLayer = 0;
+            imb.subresourceRange.layerCount = 1;
+            imb.srcAccessMask = src_access_flags;
+            imb.dstAccessMask = dst_access_flags;
+            return imb;
+        }
+    }// namespace
+
+    Defragmenter::Defragmenter(const VulkanMainContext& vmc, VulkanCommandContext& vcc, uint32_t frames_in_flight) : vmc(vmc), vcc(vcc), frames_in_flight(frames_in_flight)
+    {
+        cb = vcc.command_pools[0].create_command_buffers(1)[0];
+        fence = vcc.sync.add_fence();
+    }
+
+    std::optional<Defragmenter::Relocations> Defragmenter::update(bool can_begin)
+    {
+        if (state == State::Copying)
+        {
+            if (!is_copy_finished()) return std::nullopt;
+            return switch_resources();
+        }
+        if (state == State::Retiring)
+        {
+            if (--frames_until_retired == 0) end_pass();
+            return std::nullopt;
+        }
+        if (!can_begin) return std::nullopt;
+        if (context == VK_NULL_HANDLE)
+        {
+            if (--frames_until_check > 0) return std::nullopt;
+            frames_until_check = check_interval;
+            if (!begin_defragmentation()) return std::nullopt;
+        }
+        begin_pass();
+        return std::nullopt;
+    }
+
+    std::optional<Defragmenter::Relocations> Defragmenter::finish()
+    {
+        if (state != State::Copying) return std::nullopt;
+        vcc.sync.wait_for_fence(fence);
+        return switch_resources();
+    }
+
+    const Defragmenter::Stats& Defragmenter::get_stats() const
+    {
+        return stats;
+    }
+
+    void Defragmenter::self_destruct()
+    {
+        VE_ASSERT(state != State::Copying, "Relocations of the defragmentation have to be applied before it is destroyed!\n");
+        vcc.sync.wait_idle();
+        if (state == State::Retiring) end_pass();
+        if (context != VK_NULL_HANDLE) end_defragmentation();
+        vcc.command_pools[0].free_command_buffers({cb});
+    }
+
+    bool Defragmenter::begin_defragmentation()
+    {
+        for (AllocationClass allocation_class: movable_classes)
+        {
+            VmaPool pool = vmc.memory_pools.get_movable_pool(allocation_class);
+            if (pool == VK_NULL_HANDLE) continue;
+            VmaStatistics statistics;
+            vmaGetPoolStatistics(vmc.va, pool, &statistics);
+            // moving allocations only pays off if it frees at least one block
+            const vk::DeviceSize unused_bytes = statistics.blockBytes - statistics.allocationBytes;
+            if (statistics.blockCount < 2 || unused_bytes < vmc.memory_pools.get_block_size(allocation_class)) continue;
+
+            VmaDefragmentationInfo vdi{};
+            vdi.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+            vdi.pool = pool;
+            vdi.maxBytesPerPass = max_bytes_per_pass;
+            vdi.maxAllocationsPerPass = max_allocations_per_pass;
+            VE_CHECK(vk::Result(vmaBeginDefragmentation(vmc.va, &vdi, &context)), "Failed to begin defragmentation!");
+            VE_LOG_CONSOLE(VE_INFO, "Defragmenting memory pool with " << unused_bytes / mib << " MiB unused in " << statistics.blockCount << " blocks\n");
+            return true;
+        }
+        return false;
+    }
+
+    void Defragmenter::end_defragmentation()
+    {
+        VmaDefragmentationStats vds{};
+        vmaEndDefragmentation(vmc.va, context, &vds);
+        context = VK_NULL_HANDLE;
+        ++stats.defragmentations;
+        stats.bytes_moved += vds.bytesMoved;
+        stats.bytes_freed += vds.bytesFreed;
+        stats.allocations_moved += vds.allocationsMoved;
+        stats.blocks_freed += vds.deviceMemoryBlocksFreed;
+        VE_LOG_CONSOLE(VE_INFO, "Defragmentation moved " << vds.allocationsMoved << " allocations (" << vds.bytesMoved / mib << " MiB) and reclaimed " << vds.deviceMemoryBlocksFreed << " blocks (" << vds.bytesFreed / mib << " MiB)\n");
+    }
+
+    void Defragmenter::begin_pass()
+    {
+        const VkResult result = vmaBeginDefragmentationPass(vmc.va, context, &pass);
+        if (result == VK_SUCCESS)
+        {
+            end_defragmentation();
+            return;
+        }
+        if (result != VK_INCOMPLETE) VE_THROW("Failed to begin defragmentation pass!");
+
+        moves.clear();
+        moves_images = false;
+        vcc.begin(cb);
+        for (uint32_t i = 0; i < pass.moveCount; ++i)
+        {
+            VmaDefragmentationMove& vdm = pass.pMoves[i];
+            std::optional<MemoryPools::MovableResource> resource = vmc.memory_pools.get_movable_resource(vdm.srcAllocation);
+            // allocations without a create info cannot be recreated
+            if (!resource.has_value())
+            {
+                vdm.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                continue;
+            }
+            Move move{vdm.srcAllocation, resource.value(), resource.value()};
+            if (resource->buffer)
+            {
+                move.new_resource.buffer = vmc.logical_device.get().createBuffer(resource->bci);
+                VE_CHECK(vk::Result(vmaBindBufferMemory(vmc.va, vdm.dstTmpAllocation, move.new_resource.buffer)), "Failed to bind moved buffer!");
+            }
+            else
+            {
+                move.new_resource.image = vmc.logical_device.get().createImage(resource->ici);
+                VE_CHECK(vk::Result(vmaBindImageMemory(vmc.va, vdm.dstTmpAllocation, move.new_resource.image)), "Failed to bind moved image!");
+                moves_images = true;
+            }
+            record_copy(move);
+            moves.push_back(move);
+        }
+        if (moves.empty())
+        {
+            cb.end();
+            cb.reset();
+            end_pass();
+            return;
+        }
+
+        // all later graphics submits can use the new resources
+        vk::MemoryBarrier mb{};
+        mb.sType = vk::StructureType::eMemoryBarrier;
+        mb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        mb.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, mb, {}, {});
+        cb.end();
+        vcc.sync.reset_fence(fence);
+        vk::SubmitInfo si{};
+        si.sType = vk::StructureType::eSubmitInfo;
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &cb;
+        vmc.get_graphics_queue().submit(si, vcc.sync.get_fence(fence));
+        state = State::Copying;
+    }
+
+    void Defragmenter::record_copy(const Move& move)
+    {
+        if (move.old_resource.buffer)
+        {
+            vk::BufferCopy copy_region{};
+            copy_region.srcOffset = 0;
+            copy_region.dstOffset = 0;
+            copy_region.size = move.old_resource.bci.size;
+            cb.copyBuffer(move.old_resource.buffer, move.new_resource.buffer, copy_region);
+            return;
+        }
+
+        // textures are only moved while no upload is pending, so they are always ready for sampling
+        // the old image is sampled by the frames that are recorded until the switch, so it is transitioned back after the copy
+        const vk::ImageCreateInfo& ici = move.old_resource.ici;
+        std::array<vk::ImageMemoryBarrier, 2> before = {
+                image_barrier(move.old_resource.image, ici.mipLevels, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal, {}, vk::AccessFlagBits::eTransferRead),
+                image_barrier(move.new_resource.image, ici.mipLevels, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, {}, vk::AccessFlagBits::eTransferWrite)};
+        cb.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, before);
+        std::vector<vk::ImageCopy> copy_regions;
+        for (uint32_t i = 0; i < ici.mipLevels; ++i)
+        {
+            vk::ImageCopy copy_region{};
+            copy_region.srcSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1);
+            copy_region.srcOffset = vk::Offset3D{0, 0, 0};
+            copy_region.dstSubresource = vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, i, 0, 1);
+            copy_region.dstOffset = vk::Offset3D{0, 0, 0};
+            copy_region.extent = vk::Extent3D{std::max(1u, ici.extent.width >> i), std::max(1u, ici.extent.height >> i), 1};
+            copy_regions.push_back(copy_region);
+        }
+        cb.copyImage(move.old_resource.image, vk::ImageLayout::eTransferSrcOptimal, move.new_resource.image, vk::ImageLayout::eTransferDstOptimal, copy_regions);
+        std::array<vk::ImageMemoryBarrier, 2> after = {
+                image_barrier(move.old_resource.image, ici.mipLevels, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, {}, vk::AccessFlagBits::eShaderRead),
+                image_barrier(move.new_resource.image, ici.mipLevels, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead)};
+        cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {}, after);
+    }
+
+    Defragmenter::Relocations Defragmenter::switch_resources()
+    {
+        cb.reset();
+        // descriptor sets that are used by frames in flight must not be updated
+        if (moves_images) vcc.sync.wait_idle();
+        Relocations relocations;
+        for (const Move& move: moves)
+        {
+            if (move.old_resource.buffer)
+            {
+                relocations.buffers.emplace(move.old_resource.buffer, move.new_resource.buffer);
+                vmc.memory_pools.set_movable_handle(move.vmaa, move.new_resource.buffer);
+            }
+            else
+            {
+                relocations.images.emplace(move.old_resource.image, move.new_resource.image);
+                vmc.memory_pools.set_movable_handle(move.vmaa, move.new_resource.image);
+            }
+        }
+        // the frames that were recorded before the switch still use the old resources
+        state = State::Retiring;
+        frames_until_retired = frames_in_flight;
+        return relocations;
+    }
+
+    void Defragmenter::end_pass()
+    {
+        for (const Move& move: moves)
+        {
+            if (move.old_resource.buffer) vmc.logical_device.get().destroyBuffer(move.old_resource.buffer);
+            else vmc.logical_device.get().destroyImage(move.old_resource.image);
+        }
+        moves.clear();
+        state = State::Idle;
+        const VkResult result = vmaEndDefragmentationPass(vmc.va, context, &pass);
+        if (result == VK_SUCCESS) end_defragmentation();
+        else if (result != VK_INCOMPLETE) VE_THROW("Failed to end defragmentation pass!");
+    }
+
+    bool Defragmenter::is_copy_finished() const
+    {
+        return vmc.logical_device.get().getFenceStatus(vcc.sync.get_fence(fence)) == vk::Result::eSuccess;
+    }
+}// namespace ve
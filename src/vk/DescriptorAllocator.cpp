@@ -0,0 +1,67 @@
+#include "vk/DescriptorAllocator.hpp"
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    DescriptorAllocator::DescriptorAllocator(const vk::Device& logical_device) : device(logical_device)
+    {}
+
+    std::vector<vk::DescriptorSet> DescriptorAllocator::allocate(vk::DescriptorSetLayout layout, const std::vector<vk::DescriptorSetLayoutBinding>& bindings, uint32_t count)
+    {
+        std::map<vk::DescriptorType, uint32_t> descriptor_counts;
+        for (const auto& binding: bindings)
+        {
+            descriptor_counts[binding.descriptorType] += binding.descriptorCount;
+        }
+        const PoolSizes pool_sizes(descriptor_counts.begin(), descriptor_counts.end());
+        std::vector<vk::DescriptorPool>& pools = pool_chains[pool_sizes];
+
+        std::vector<vk::DescriptorSet> sets(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (pools.empty()) add_pool(pool_sizes, pools);
+            vk::DescriptorSetAllocateInfo dsai{};
+            dsai.sType = vk::StructureType::eDescriptorSetAllocateInfo;
+            dsai.descriptorPool = pools.back();
+            dsai.descriptorSetCount = 1;
+            dsai.pSetLayouts = &layout;
+            vk::Result result = device.allocateDescriptorSets(&dsai, &sets[i]);
+            if (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool)
+            {
+                add_pool(pool_sizes, pools);
+                dsai.descriptorPool = pools.back();
+                result = device.allocateDescriptorSets(&dsai, &sets[i]);
+            }
+            VE_CHECK(result, "Failed to allocate descriptor set!");
+        }
+        return sets;
+    }
+
+    void DescriptorAllocator::self_destruct()
+    {
+        for (auto& [pool_sizes, pools]: pool_chains)
+        {
+            for (auto& pool: pools)
+            {
+                device.destroyDescriptorPool(pool);
+            }
+        }
+        pool_chains.clear();
+    }
+
+    void DescriptorAllocator::add_pool(const PoolSizes& pool_sizes, std::vector<vk::DescriptorPool>& pools)
+    {
+        std::vector<vk::DescriptorPoolSize> dps;
+        for (const auto& [type, count]: pool_sizes)
+        {
+            if (count > 0) dps.push_back(vk::DescriptorPoolSize(type, count * sets_per_pool));
+        }
+        vk::DescriptorPoolCreateInfo dpci{};
+        dpci.sType = vk::StructureType::eDescriptorPoolCreateInfo;
+        dpci.poolSizeCount = dps.size();
+        dpci.pPoolSizes = dps.data();
+        dpci.maxSets = sets_per_pool;
+        pools.push_back(device.createDescriptorPool(dpci));
+    }
+}// namespace ve
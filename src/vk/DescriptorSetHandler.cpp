@@ -1,8 +1,11 @@
 #include "vk/DescriptorSetHandler.hpp"
 
+#include <array>
+#include <cstddef>
+
 namespace ve
 {
-    DescriptorSetHandler::DescriptorSetHandler(const VulkanMainContext& vmc) : vmc(vmc)
+    DescriptorSetHandler::DescriptorSetHandler(const VulkanMainContext& vmc) : vmc(vmc), allocator(vmc.logical_device.get())
     {}
 
     uint32_t DescriptorSetHandler::new_set()
@@ -29,7 +32,7 @@ namespace ve
         dbi.buffer = buffer.get();
         dbi.offset = 0;
         dbi.range = buffer.get_byte_size();
-        descriptor_sets.back().push_back(Descriptor(binding, dbi, {}));
+        descriptor_sets.back().push_back(Descriptor(binding, dbi));
     }
 
     void DescriptorSetHandler::add_descriptor(uint32_t binding, const Image& image)
@@ -38,7 +41,7 @@ namespace ve
         dii.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
         dii.imageView = image.get_view();
         dii.sampler = image.get_sampler();
-        descriptor_sets.back().push_back(Descriptor(binding, {}, dii));
+        descriptor_sets.back().push_back(Descriptor(binding, dii));
     }
 
     void DescriptorSetHandler::apply_descriptor_to_new_sets(uint32_t binding, const Buffer& buffer)
@@ -47,7 +50,7 @@ namespace ve
         dbi.buffer = buffer.get();
         dbi.offset = 0;
         dbi.range = buffer.get_byte_size();
-        new_set_descriptors.push_back(Descriptor(binding, dbi, {}));
+        new_set_descriptors.push_back(Descriptor(binding, dbi));
     }
 
     void DescriptorSetHandler::reset_auto_apply_bindings()
@@ -55,6 +58,12 @@ namespace ve
         new_set_descriptors.clear();
     }
 
+    void DescriptorSetHandler::use_push_descriptors()
+    {
+        VE_ASSERT(vmc.logical_device.supports_push_descriptors(), "Push descriptors are not supported!\n");
+        push_descriptors = true;
+    }
+
     void DescriptorSetHandler::construct()
     {
         std::sort(layout_bindings.begin(), layout_bindings.end());
@@ -62,75 +71,107 @@ namespace ve
         {
             std::sort(descriptors.begin(), descriptors.end());
         }
-        std::vector<vk::DescriptorPoolSize> pool_sizes;
-        for (const auto& dslb: layout_bindings)
+        if (push_descriptors)
         {
-            vk::DescriptorPoolSize dps{};
-            dps.type = dslb.descriptorType;
-            dps.descriptorCount = descriptor_sets.size();
-            pool_sizes.push_back(dps);
+            VE_ASSERT(layout_bindings.size() <= max_push_descriptors, "Too many bindings for a push descriptor layout!\n");
+            layout = vmc.descriptor_set_layouts.get(layout_bindings, vk::DescriptorSetLayoutCreateFlagBits::ePushDescriptorKHR);
+            return;
         }
+        layout = vmc.descriptor_set_layouts.get(layout_bindings);
+        sets = allocator.allocate(layout, layout_bindings, descriptor_sets.size());
 
+        create_update_template();
         for (uint32_t i = 0; i < descriptor_sets.size(); ++i)
         {
-            vk::DescriptorSetLayoutCreateInfo dslci{};
-            dslci.sType = vk::StructureType::eDescriptorSetLayoutCreateInfo;
-            dslci.bindingCount = layout_bindings.size();
-            dslci.pBindings = layout_bindings.data();
-            layouts.push_back(vmc.logical_device.get().createDescriptorSetLayout(dslci));
+            write_set(i);
         }
+    }
 
-        vk::DescriptorPoolCreateInfo dpci{};
-        dpci.sType = vk::StructureType::eDescriptorPoolCreateInfo;
-        dpci.poolSizeCount = pool_sizes.size();
-        dpci.pPoolSizes = pool_sizes.data();
-        dpci.maxSets = descriptor_sets.size();
+    void DescriptorSetHandler::bind(const vk::CommandBuffer& cb, vk::PipelineLayout pipeline_layout, DescriptorSetFrequency frequency, uint32_t set)
+    {
+        if (bound_set == set) return;
+        bound_set = set;
+        if (!push_descriptors)
+        {
+            cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, uint32_t(frequency), sets[set], {});
+            return;
+        }
+        std::array<vk::WriteDescriptorSet, max_push_descriptors> wds_s;
+        uint32_t write_count = 0;
+        for (const Descriptor& descriptor: descriptor_sets[set])
+        {
+            wds_s[write_count++] = get_write(descriptor, {});
+        }
+        VE_ASSERT(write_count > 0, "Pushed descriptor set " << set << " has no descriptors!\n");
+        vmc.logical_device.push_descriptor_set(cb, vk::PipelineBindPoint::eGraphics, pipeline_layout, uint32_t(frequency), write_count, wds_s.data());
+    }
 
-        pool = vmc.logical_device.get().createDescriptorPool(dpci);
+    void DescriptorSetHandler::reset_binding()
+    {
+        bound_set.reset();
+    }
 
-        vk::DescriptorSetAllocateInfo dsai{};
-        dsai.sType = vk::StructureType::eDescriptorSetAllocateInfo;
-        dsai.descriptorPool = pool;
-        dsai.descriptorSetCount = layouts.size();
-        dsai.pSetLayouts = layouts.data();
+    bool DescriptorSetHandler::has_bindings() const
+    {
+        return !layout_bindings.empty();
+    }
 
-        sets = vmc.logical_device.get().allocateDescriptorSets(dsai);
+    void DescriptorSetHandler::update_descriptor(uint32_t set, uint32_t binding, const Image& image)
+    {
+        vk::DescriptorImageInfo dii{};
+        dii.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+        dii.imageView = image.get_view();
+        dii.sampler = image.get_sampler();
+        find_descriptor(set, binding).info.image = dii;
+        write_set(set);
+    }
 
-        std::vector<vk::WriteDescriptorSet> wds_s;
+    void DescriptorSetHandler::update_descriptor(uint32_t set, uint32_t binding, const Buffer& buffer)
+    {
+        vk::DescriptorBufferInfo dbi{};
+        dbi.buffer = buffer.get();
+        dbi.offset = 0;
+        dbi.range = buffer.get_byte_size();
+        find_descriptor(set, binding).info.buffer = dbi;
+        write_set(set);
+    }
+
+    void DescriptorSetHandler::relocate(const Defragmenter::Relocations& relocations)
+    {
         for (uint32_t i = 0; i < descriptor_sets.size(); ++i)
         {
-            for (uint32_t j = 0; j < descriptor_sets[i].size(); ++j)
+            bool relocated = false;
+            for (Descriptor& descriptor: descriptor_sets[i])
             {
-                vk::WriteDescriptorSet wds{};
-                wds.sType = vk::StructureType::eWriteDescriptorSet;
-                wds.dstSet = sets[i];
-                wds.dstBinding = layout_bindings[j].binding;
-                wds.dstArrayElement = 0;
-
-                wds.descriptorType = layout_bindings[j].descriptorType;
-                wds.descriptorCount = 1;
-                wds.pBufferInfo = &(descriptor_sets[i][j].dbi);
-                wds.pImageInfo = &(descriptor_sets[i][j].dii);
-                wds.pTexelBufferView = nullptr;
-
-                wds_s.push_back(wds);
+                if (descriptor.is_image)
+                {
+                    auto it = relocations.image_views.find(descriptor.info.image.imageView);
+                    if (it == relocations.image_views.end()) continue;
+                    descriptor.info.image.imageView = it->second;
+                }
+                else
+                {
+                    auto it = relocations.buffers.find(descriptor.info.buffer.buffer);
+                    if (it == relocations.buffers.end()) continue;
+                    descriptor.info.buffer.buffer = it->second;
+                }
+                relocated = true;
             }
+            if (relocated) write_set(i);
         }
-        vmc.logical_device.get().updateDescriptorSets(wds_s, {});
     }
 
     void DescriptorSetHandler::self_destruct()
     {
-        vmc.logical_device.get().destroyDescriptorPool(pool);
-        for (auto& dsl: layouts)
-        {
-            vmc.logical_device.get().destroyDescriptorSetLayout(dsl);
-        }
+        if (update_template) vmc.logical_device.get().destroyDescriptorUpdateTemplate(update_template);
+        update_template = vk::DescriptorUpdateTemplate();
+        allocator.self_destruct();
+        sets.clear();
     }
 
-    const std::vector<vk::DescriptorSetLayout>& DescriptorSetHandler::get_layouts() const
+    vk::DescriptorSetLayout DescriptorSetHandler::get_layout() const
     {
-        return layouts;
+        return layout;
     }
 
     const std::vector<vk::DescriptorSet>& DescriptorSetHandler::get_sets() const
@@ -138,4 +179,71 @@ namespace ve
         return sets;
     }
 
+    void DescriptorSetHandler::create_update_template()
+    {
+        std::vector<vk::DescriptorUpdateTemplateEntry> entries;
+        for (uint32_t j = 0; j < layout_bindings.size(); ++j)
+        {
+            vk::DescriptorUpdateTemplateEntry dute{};
+            dute.dstBinding = layout_bindings[j].binding;
+            dute.dstArrayElement = 0;
+            dute.descriptorCount = 1;
+            dute.descriptorType = layout_bindings[j].descriptorType;
+            dute.offset = j * sizeof(Descriptor) + offsetof(Descriptor, info);
+            dute.stride = sizeof(Descriptor);
+            entries.push_back(dute);
+        }
+        vk::DescriptorUpdateTemplateCreateInfo dutci{};
+        dutci.sType = vk::StructureType::eDescriptorUpdateTemplateCreateInfo;
+        dutci.descriptorUpdateEntryCount = entries.size();
+        dutci.pDescriptorUpdateEntries = entries.data();
+        dutci.templateType = vk::DescriptorUpdateTemplateType::eDescriptorSet;
+        dutci.descriptorSetLayout = layout;
+        update_template = vmc.logical_device.get().createDescriptorUpdateTemplate(dutci);
+    }
+
+    void DescriptorSetHandler::write_set(uint32_t set)
+    {
+        // pushed descriptors are read from descriptor_sets every time the set is bound
+        if (push_descriptors) return;
+        const std::vector<Descriptor>& descriptors = descriptor_sets[set];
+        if (descriptors.size() == layout_bindings.size())
+        {
+            vmc.logical_device.get().updateDescriptorSetWithTemplate(sets[set], update_template, descriptors.data());
+            return;
+        }
+        // sets that leave bindings empty, e.g. meshes without a texture, are written descriptor by descriptor
+        std::vector<vk::WriteDescriptorSet> wds_s;
+        for (const Descriptor& descriptor: descriptors)
+        {
+            wds_s.push_back(get_write(descriptor, sets[set]));
+        }
+        if (!wds_s.empty()) vmc.logical_device.get().updateDescriptorSets(wds_s, {});
+    }
+
+    vk::WriteDescriptorSet DescriptorSetHandler::get_write(const Descriptor& descriptor, vk::DescriptorSet dst_set) const
+    {
+        vk::WriteDescriptorSet wds{};
+        wds.sType = vk::StructureType::eWriteDescriptorSet;
+        wds.dstSet = dst_set;
+        wds.dstBinding = descriptor.binding;
+        wds.dstArrayElement = 0;
+        wds.descriptorCount = 1;
+        for (const auto& dslb: layout_bindings)
+        {
+            if (dslb.binding == descriptor.binding) wds.descriptorType = dslb.descriptorType;
+        }
+        if (descriptor.is_image) wds.pImageInfo = reinterpret_cast<const vk::DescriptorImageInfo*>(&descriptor.info.image);
+        else wds.pBufferInfo = reinterpret_cast<const vk::DescriptorBufferInfo*>(&descriptor.info.buffer);
+        return wds;
+    }
+
+    DescriptorSetHandler::Descriptor& DescriptorSetHandler::find_descriptor(uint32_t set, uint32_t binding)
+    {
+        for (Descriptor& descriptor: descriptor_sets[set])
+        {
+            if (descriptor.binding == binding) return descriptor;
+        }
+        VE_THROW("Set " << set << " has no descriptor for binding " << binding << "!\n");
+    }
 }// namespace ve
@@ -0,0 +1,84 @@
+#include "vk/DescriptorSetLayoutCache.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        void hash_combine(size_t& seed, size_t value)
+        {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+    }// namespace
+
+    DescriptorSetLayoutCache::DescriptorSetLayoutCache(const LogicalDevice& logical_device) : logical_device(logical_device)
+    {}
+
+    vk::DescriptorSetLayout DescriptorSetLayoutCache::get(const std::vector<vk::DescriptorSetLayoutBinding>& bindings, vk::DescriptorSetLayoutCreateFlags flags, const std::vector<vk::DescriptorBindingFlags>& binding_flags) const
+    {
+        VE_ASSERT(binding_flags.empty() || binding_flags.size() == bindings.size(), "Binding flags do not match the bindings!\n");
+        std::vector<uint32_t> order(bindings.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return bindings[a].binding < bindings[b].binding; });
+        Key key{flags, {}, {}};
+        for (uint32_t i: order)
+        {
+            key.bindings.push_back(bindings[i]);
+            if (!binding_flags.empty()) key.binding_flags.push_back(binding_flags[i]);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = layouts.find(key);
+        if (it != layouts.end()) return it->second;
+
+        vk::DescriptorSetLayoutCreateInfo dslci{};
+        dslci.sType = vk::StructureType::eDescriptorSetLayoutCreateInfo;
+        dslci.flags = key.flags;
+        dslci.bindingCount = key.bindings.size();
+        dslci.pBindings = key.bindings.data();
+        vk::DescriptorSetLayoutBindingFlagsCreateInfo dslbfci{};
+        dslbfci.sType = vk::StructureType::eDescriptorSetLayoutBindingFlagsCreateInfo;
+        dslbfci.bindingCount = key.binding_flags.size();
+        dslbfci.pBindingFlags = key.binding_flags.data();
+        if (!key.binding_flags.empty()) dslci.pNext = &dslbfci;
+        vk::DescriptorSetLayout layout = logical_device.get().createDescriptorSetLayout(dslci);
+        layouts.emplace(std::move(key), layout);
+        VE_LOG_CONSOLE(VE_DEBUG, "Created descriptor set layout with " << dslci.bindingCount << " bindings, " << layouts.size() << " layouts are cached\n");
+        return layout;
+    }
+
+    void DescriptorSetLayoutCache::self_destruct()
+    {
+        for (auto& [key, layout]: layouts)
+        {
+            logical_device.get().destroyDescriptorSetLayout(layout);
+        }
+        layouts.clear();
+    }
+
+    bool DescriptorSetLayoutCache::Key::operator==(const Key& other) const
+    {
+        return flags == other.flags && bindings == other.bindings && binding_flags == other.binding_flags;
+    }
+
+    size_t DescriptorSetLayoutCache::KeyHash::operator()(const Key& key) const
+    {
+        size_t seed = std::hash<uint32_t>()(uint32_t(key.flags));
+        for (const vk::DescriptorSetLayoutBinding& dslb: key.bindings)
+        {
+            hash_combine(seed, std::hash<uint32_t>()(dslb.binding));
+            hash_combine(seed, std::hash<uint32_t>()(uint32_t(dslb.descriptorType)));
+            hash_combine(seed, std::hash<uint32_t>()(dslb.descriptorCount));
+            hash_combine(seed, std::hash<uint32_t>()(uint32_t(dslb.stageFlags)));
+            hash_combine(seed, std::hash<const void*>()(dslb.pImmutableSamplers));
+        }
+        for (const vk::DescriptorBindingFlags& flags: key.binding_flags)
+        {
+            hash_combine(seed, std::hash<uint32_t>()(uint32_t(flags)));
+        }
+        return seed;
+    }
+}// namespace ve
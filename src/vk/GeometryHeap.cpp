@@ -0,0 +1,132 @@
+#include "vk/GeometryHeap.hpp"
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    GeometryHeap::RangeAllocator::RangeAllocator(vk::DeviceSize size)
+    {
+        free_ranges.emplace(0, size);
+    }
+
+    std::optional<vk::DeviceSize> GeometryHeap::RangeAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+    {
+        for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+        {
+            const vk::DeviceSize aligned_offset = (it->first + alignment - 1) / alignment * alignment;
+            const vk::DeviceSize padding = aligned_offset - it->first;
+            if (it->second < padding + size) continue;
+            const auto [range_offset, range_size] = *it;
+            free_ranges.erase(it);
+            // the padding and the rest of the range stay free
+            if (padding > 0) free_ranges.emplace(range_offset, padding);
+            if (range_size > padding + size) free_ranges.emplace(aligned_offset + size, range_size - padding - size);
+            return aligned_offset;
+        }
+        return std::nullopt;
+    }
+
+    void GeometryHeap::RangeAllocator::free(vk::DeviceSize offset, vk::DeviceSize size)
+    {
+        if (size == 0) return;
+        auto it = free_ranges.emplace(offset, size).first;
+        auto next = std::next(it);
+        if (next != free_ranges.end() && it->first + it->second == next->first)
+        {
+            it->second += next->second;
+            free_ranges.erase(next);
+        }
+        if (it != free_ranges.begin())
+        {
+            auto prev = std::prev(it);
+            if (prev->first + prev->second == it->first)
+            {
+                prev->second += it->second;
+                free_ranges.erase(it);
+            }
+        }
+    }
+
+    GeometryHeap::GeometryHeap(const VulkanMainContext& vmc) : vmc(vmc)
+    {}
+
+    GeometryHeap::Allocation GeometryHeap::allocate(vk::DeviceSize vertex_size, vk::DeviceSize vertex_stride, vk::DeviceSize index_size)
+    {
+        Allocation allocation;
+        allocation.vertex_size = vertex_size;
+        allocation.index_size = index_size;
+        for (allocation.block = 0; allocation.block < blocks.size(); ++allocation.block)
+        {
+            Block& block = blocks[allocation.block];
+            std::optional<vk::DeviceSize> vertex_offset = block.vertex_ranges.allocate(vertex_size, vertex_stride);
+            if (!vertex_offset.has_value()) continue;
+            std::optional<vk::DeviceSize> index_offset = block.index_ranges.allocate(index_size, index_alignment);
+            if (!index_offset.has_value())
+            {
+                block.vertex_ranges.free(vertex_offset.value(), vertex_size);
+                continue;
+            }
+            allocation.vertex_offset = vertex_offset.value();
+            allocation.index_offset = index_offset.value();
+            allocation.first_vertex = int32_t(allocation.vertex_offset / vertex_stride);
+            return allocation;
+        }
+
+        // models that are larger than the default block size get a block of their own
+        const vk::DeviceSize new_vertex_size = std::max(vertex_block_size, (vertex_size + vertex_block_size - 1) / vertex_block_size * vertex_block_size);
+        const vk::DeviceSize new_index_size = std::max(index_block_size, (index_size + index_block_size - 1) / index_block_size * index_block_size);
+        blocks.push_back(Block{Buffer(vmc, new_vertex_size, vk::BufferUsageFlagBits::eVertexBuffer, AllocationClass::Geometry), Buffer(vmc, new_index_size, vk::BufferUsageFlagBits::eIndexBuffer, AllocationClass::Geometry), RangeAllocator(new_vertex_size), RangeAllocator(new_index_size)});
+        VE_LOG_CONSOLE(VE_INFO, "Created geometry heap block " << blocks.size() - 1 << " with " << new_vertex_size / (1024 * 1024) << " MiB vertices and " << new_index_size / (1024 * 1024) << " MiB indices\n");
+        allocation.vertex_offset = blocks.back().vertex_ranges.allocate(vertex_size, vertex_stride).value();
+        allocation.index_offset = blocks.back().index_ranges.allocate(index_size, index_alignment).value();
+        allocation.first_vertex = 0;
+        return allocation;
+    }
+
+    void GeometryHeap::free(const Allocation& allocation)
+    {
+        blocks[allocation.block].vertex_ranges.free(allocation.vertex_offset, allocation.vertex_size);
+        blocks[allocation.block].index_ranges.free(allocation.index_offset, allocation.index_size);
+    }
+
+    void GeometryHeap::upload(UploadContext& upload, const Allocation& allocation, std::span<const unsigned char> vertex_data, std::span<const unsigned char> index_data)
+    {
+        VE_ASSERT(vertex_data.size() <= allocation.vertex_size && index_data.size() <= allocation.index_size, "Geometry is larger than its allocation!\n");
+        if (!vertex_data.empty()) upload.copy_to_buffer(vertex_data.data(), vertex_data.size(), blocks[allocation.block].vertex_buffer.get(), allocation.vertex_offset);
+        if (!index_data.empty()) upload.copy_to_buffer(index_data.data(), index_data.size(), blocks[allocation.block].index_buffer.get(), allocation.index_offset);
+    }
+
+    void GeometryHeap::bind(const vk::CommandBuffer& cb, uint32_t block, vk::IndexType index_type)
+    {
+        if (bound_block != block) cb.bindVertexBuffers(0, blocks[block].vertex_buffer.get(), {0});
+        if (bound_block != block || bound_index_type != index_type) cb.bindIndexBuffer(blocks[block].index_buffer.get(), 0, index_type);
+        bound_block = block;
+        bound_index_type = index_type;
+    }
+
+    void GeometryHeap::reset_binding()
+    {
+        bound_block.reset();
+        bound_index_type.reset();
+    }
+
+    void GeometryHeap::relocate(const Defragmenter::Relocations& relocations)
+    {
+        // only whole buffers are moved, so the offsets of the allocations stay valid
+        for (auto& block: blocks)
+        {
+            block.vertex_buffer.relocate(relocations);
+            block.index_buffer.relocate(relocations);
+        }
+    }
+
+    void GeometryHeap::self_destruct()
+    {
+        for (auto& block: blocks)
+        {
+            block.vertex_buffer.self_destruct();
+            block.index_buffer.self_destruct();
+        }
+        blocks.clear();
+    }
+}// namespace ve
@@ -0,0 +1,171 @@
+#include "vk/GlbFile.hpp"
+
+#include <cstring>
+
+#include "json.hpp"
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        constexpr uint32_t glb_magic = 0x46546C67;// "glTF"
+        constexpr uint32_t glb_chunk_json = 0x4E4F534A;
+        constexpr uint32_t glb_chunk_bin = 0x004E4942;
+
+        struct Header {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t length;
+        };
+
+        struct ChunkHeader {
+            uint32_t length;
+            uint32_t type;
+        };
+    }// namespace
+
+    GlbFile::GlbFile(const std::string& path) : base_dir(path.substr(0, path.find_last_of('/') + 1)), file(path)
+    {
+        if (file.is_open() && !parse()) json_chunk = {};
+    }
+
+    bool GlbFile::is_valid() const
+    {
+        return !json_chunk.empty();
+    }
+
+    const unsigned char* GlbFile::data() const
+    {
+        return file.data();
+    }
+
+    std::size_t GlbFile::size() const
+    {
+        return file.size();
+    }
+
+    bool GlbFile::parse()
+    {
+        Header header;
+        if (file.size() < sizeof(Header) + sizeof(ChunkHeader)) return false;
+        memcpy(&header, file.data(), sizeof(Header));
+        if (header.magic != glb_magic || header.version != 2 || header.length > file.size()) return false;
+        // the first chunk has to contain the JSON document, the optional second one the binary buffer
+        std::size_t offset = sizeof(Header);
+        while (offset + sizeof(ChunkHeader) <= header.length)
+        {
+            ChunkHeader chunk;
+            memcpy(&chunk, file.data() + offset, sizeof(ChunkHeader));
+            offset += sizeof(ChunkHeader);
+            if (chunk.length > header.length - offset) return false;
+            std::span<const unsigned char> chunk_data(file.data() + offset, chunk.length);
+            if (chunk.type == glb_chunk_json && json_chunk.empty()) json_chunk = chunk_data;
+            else if (chunk.type == glb_chunk_bin && !json_chunk.empty() && bin_chunk.empty()) bin_chunk = chunk_data;
+            // chunks are padded to 4 bytes
+            offset += (chunk.length + 3) & ~3u;
+        }
+        return !json_chunk.empty();
+    }
+
+    bool GlbFile::load(tinygltf::Model& model, std::string* err, std::string* warn, tinygltf::LoadImageDataFunction image_loader, void* user_data)
+    {
+        using json = nlohmann::json;
+        json document = json::parse(json_chunk.begin(), json_chunk.end(), nullptr, false);
+        if (document.is_discarded() || !document.is_object())
+        {
+            if (err) (*err) += "Invalid JSON chunk in glb file\n";
+            return false;
+        }
+        // tinygltf copies buffers and embedded images while parsing, so they are removed from the document and handled here
+        const json buffer_array = document.value("buffers", json::array());
+        const json image_array = document.value("images", json::array());
+        document.erase("buffers");
+        document.erase("images");
+        const std::string stripped_document = document.dump();
+        tinygltf::TinyGLTF loader;
+        if (!loader.LoadASCIIFromString(&model, err, warn, stripped_document.c_str(), stripped_document.size(), base_dir)) return false;
+
+        buffers.clear();
+        for (uint32_t i = 0; i < buffer_array.size(); ++i)
+        {
+            const json& b = buffer_array[i];
+            tinygltf::Buffer& buffer = model.buffers.emplace_back();
+            buffer.name = b.value("name", "");
+            buffer.uri = b.value("uri", "");
+            // a buffer without uri refers to the BIN chunk
+            std::span<const unsigned char> data = buffer.uri.empty() ? bin_chunk : resolve_uri(buffer.uri, err);
+            const std::size_t byte_length = b.value("byteLength", std::size_t(0));
+            if (data.size() < byte_length)
+            {
+                if (err) (*err) += "Buffer " + std::to_string(i) + " is smaller than its byteLength\n";
+                return false;
+            }
+            buffers.push_back(data.first(byte_length));
+        }
+
+        for (uint32_t i = 0; i < image_array.size(); ++i)
+        {
+            const json& o = image_array[i];
+            tinygltf::Image image;
+            image.name = o.value("name", "");
+            image.mimeType = o.value("mimeType", "");
+            image.uri = o.value("uri", "");
+            image.bufferView = o.value("bufferView", -1);
+            std::span<const unsigned char> encoded = image.bufferView > -1 ? get_buffer_view(model, image.bufferView) : resolve_uri(image.uri, err);
+            if (encoded.empty())
+            {
+                if (err) (*err) += "Image " + std::to_string(i) + " has no data\n";
+                return false;
+            }
+            if (!image_loader(&image, i, err, warn, 0, 0, encoded.data(), int(encoded.size()), user_data)) return false;
+            model.images.push_back(std::move(image));
+        }
+        return true;
+    }
+
+    std::span<const unsigned char> GlbFile::get_buffer_view(const tinygltf::Model& model, int buffer_view_idx) const
+    {
+        if (buffer_view_idx < 0 || size_t(buffer_view_idx) >= model.bufferViews.size()) VE_THROW("Buffer view " << buffer_view_idx << " does not exist!");
+        const tinygltf::BufferView& view = model.bufferViews[buffer_view_idx];
+        if (view.buffer < 0 || size_t(view.buffer) >= buffers.size()) VE_THROW("Buffer " << view.buffer << " of buffer view " << buffer_view_idx << " does not exist!");
+        const std::span<const unsigned char> buffer = buffers[view.buffer];
+        if (view.byteOffset > buffer.size() || view.byteLength > buffer.size() - view.byteOffset) VE_THROW("Buffer view " << buffer_view_idx << " exceeds its buffer!");
+        return buffer.subspan(view.byteOffset, view.byteLength);
+    }
+
+    GlbFile::AccessorView GlbFile::get_accessor(const tinygltf::Model& model, int accessor_idx) const
+    {
+        if (accessor_idx < 0 || size_t(accessor_idx) >= model.accessors.size()) VE_THROW("Accessor " << accessor_idx << " does not exist!");
+        const tinygltf::Accessor& accessor = model.accessors[accessor_idx];
+        if (accessor.bufferView < 0 || accessor.sparse.isSparse) VE_THROW("Accessor " << accessor_idx << " without buffer view or with sparse storage is not supported!");
+        const std::span<const unsigned char> view = get_buffer_view(model, accessor.bufferView);
+        const int byte_stride = accessor.ByteStride(model.bufferViews[accessor.bufferView]);
+        const int element_size = tinygltf::GetComponentSizeInBytes(accessor.componentType) * tinygltf::GetNumComponentsInType(accessor.type);
+        if (byte_stride <= 0 || element_size <= 0) VE_THROW("Accessor " << accessor_idx << " has an invalid type!");
+        if (accessor.count > 0 && accessor.byteOffset + (accessor.count - 1) * byte_stride + element_size > view.size()) VE_THROW("Accessor " << accessor_idx << " exceeds its buffer view!");
+        return {view.data() + accessor.byteOffset, std::size_t(byte_stride), accessor.count};
+    }
+
+    std::span<const unsigned char> GlbFile::resolve_uri(const std::string& uri, std::string* err)
+    {
+        if (tinygltf::IsDataURI(uri))
+        {
+            std::string mime_type;
+            std::vector<unsigned char>& decoded = decoded_uris.emplace_back();
+            if (!tinygltf::DecodeDataURI(&decoded, mime_type, uri, 0, false))
+            {
+                if (err) (*err) += "Failed to decode data uri\n";
+                return {};
+            }
+            return std::span<const unsigned char>(decoded.data(), decoded.size());
+        }
+        MappedFile& external_file = external_files.emplace_back(base_dir + uri);
+        if (!external_file.is_open())
+        {
+            if (err) (*err) += "Failed to map \"" + base_dir + uri + "\"\n";
+            return {};
+        }
+        return std::span<const unsigned char>(external_file.data(), external_file.size());
+    }
+}// namespace ve
@@ -3,97 +3,118 @@
 #include <stb/stb_image.h>
 
 #include "ve_log.hpp"
-#include "vk/VulkanCommandContext.hpp"
 
 namespace ve
 {
     Image::Image(const VulkanMainContext& vmc, const std::string& name, bool use_mip_maps) : vmc(vmc), name(name), mip_levels(use_mip_maps ? 2 : 1)
     {}
 
-    Image::Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, const unsigned char* data, uint32_t width, uint32_t height, bool use_mip_maps) : vmc(vmc), w(width), h(height), byte_size(width * height * 4), mip_levels(use_mip_maps ? 2 : 1)
+    Image::Image(const VulkanMainContext& vmc, UploadContext& upload, const unsigned char* data, uint32_t width, uint32_t height, bool use_mip_maps) : vmc(vmc), w(width), h(height), byte_size(width * height * 4), mip_levels(use_mip_maps ? 2 : 1)
     {
-        create_image_from_data(data, vcc, queue_family_indices);
+        create_image_from_data(data, upload);
     }
 
-    Image::Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, Image& src_image, uint32_t base_mip_level) : vmc(vmc), mip_levels(2)
-    {
-        w = std::max(1.0, src_image.w / std::pow(2, base_mip_level));
-        h = std::max(1.0, src_image.h / std::pow(2, base_mip_level));
-        byte_size = w * h * 4;
-        constexpr vk::Format format = vk::Format::eR8G8B8A8Srgb;
-        create_image(queue_family_indices, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, format, vk::SampleCountFlagBits::e1);
-
-        src_image.transition_image_layout(vcc, vk::ImageLayout::eTransferSrcOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead);
-        transition_image_layout(vcc, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, vk::AccessFlagBits::eTransferWrite);
-        vk::FormatProperties format_properties = vmc.physical_device.get().getFormatProperties(format);
-        if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) mip_levels = 1;
-
-        const vk::CommandBuffer& cb = vcc.begin(vcc.graphics_cb[0]);
-
-        vk::ImageBlit blit{};
-        blit.srcOffsets[0] = vk::Offset3D(0, 0, 0);
-        blit.srcOffsets[1] = vk::Offset3D(w, h, 1);
-        blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        blit.srcSubresource.mipLevel = base_mip_level;
-        blit.srcSubresource.baseArrayLayer = 0;
-        blit.srcSubresource.layerCount = 1;
-        blit.dstOffsets[0] = vk::Offset3D(0, 0, 0);
-        blit.dstOffsets[1] = vk::Offset3D(w, h, 1);
-        blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        blit.dstSubresource.mipLevel = 0;
-        blit.dstSubresource.baseArrayLayer = 0;
-        blit.dstSubresource.layerCount = 1;
-        cb.blitImage(src_image.get_image(), vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, blit, vk::Filter::eLinear);
-
-        vcc.submit_graphics(cb, true);
-
-        mip_levels > 1 ? generate_mipmaps(vcc) : transition_image_layout(vcc, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
-        create_image_view(format, vk::ImageAspectFlagBits::eColor);
-        create_sampler();
-    }
-
-    Image::Image(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices, const std::string& filename, bool use_mip_maps) : vmc(vmc), name(filename), mip_levels(use_mip_maps ? 2 : 1)
+    Image::Image(const VulkanMainContext& vmc, UploadContext& upload, const std::string& filename, bool use_mip_maps) : vmc(vmc), name(filename), mip_levels(use_mip_maps ? 2 : 1)
     {
+        if (filename.ends_with(".ktx2"))
+        {
+            Ktx2Texture texture(filename);
+            VE_ASSERT(texture.is_valid(), "Failed to load image \"" << filename << "\"!\n");
+            create_image_from_ktx2(texture, 0, upload);
+            return;
+        }
         stbi_uc* pixels = stbi_load(filename.c_str(), &w, &h, &c, STBI_rgb_alpha);
         VE_ASSERT(pixels, "Failed to load image \"" << filename << "\"!\n");
         byte_size = w * h * 4;
-        create_image_from_data(pixels, vcc, queue_family_indices);
+        create_image_from_data(pixels, upload);
         stbi_image_free(pixels);
         pixels = nullptr;
     }
 
-    void Image::create_image_from_data(const unsigned char* data, const VulkanCommandContext& vcc, const std::vector<uint32_t>& queue_family_indices)
+    Image::Image(const VulkanMainContext& vmc, UploadContext& upload, const Ktx2Texture& texture, uint32_t base_mip_level) : vmc(vmc)
     {
-        Buffer buffer(vmc, data, byte_size, vk::BufferUsageFlagBits::eTransferSrc, {uint32_t(vmc.queues_family_indices.transfer)});
-
-        constexpr vk::Format format = vk::Format::eR8G8B8A8Srgb;
-        create_image(queue_family_indices, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, format, vk::SampleCountFlagBits::e1);
+        create_image_from_ktx2(texture, base_mip_level, upload);
+    }
 
-        transition_image_layout(vcc, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, vk::AccessFlagBits::eTransferWrite);
-        copy_buffer_to_image(vcc, buffer);
+    void Image::create_image_from_data(const unsigned char* data, UploadContext& upload)
+    {
+        // staging may flush the batch, so it happens before any command for this image is recorded
+        const UploadContext::StagingRegion staging = upload.stage(data, byte_size);
 
+        constexpr vk::Format format = vk::Format::eR8G8B8A8Srgb;
         vk::FormatProperties format_properties = vmc.physical_device.get().getFormatProperties(format);
         if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) mip_levels = 1;
+        create_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, format, vk::SampleCountFlagBits::e1, AllocationClass::Texture);
+
+        const vk::CommandBuffer& transfer_cb = upload.get_transfer_cb();
+        transition_image_layout(transfer_cb, vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, vk::AccessFlagBits::eTransferWrite);
+        copy_buffer_to_image(transfer_cb, staging);
+        upload.transfer_ownership(image, layout, mip_levels);
 
-        mip_levels > 1 ? generate_mipmaps(vcc) : transition_image_layout(vcc, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
+        // blits are only supported on the graphics queue
+        const vk::CommandBuffer& graphics_cb = upload.get_graphics_cb();
+        mip_levels > 1 ? generate_mipmaps(graphics_cb) : transition_image_layout(graphics_cb, vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
 
-        buffer.self_destruct();
+        create_image_view(format, vk::ImageAspectFlagBits::eColor);
+        create_sampler();
+    }
+
+    void Image::create_image_from_ktx2(const Ktx2Texture& texture, uint32_t base_mip_level, UploadContext& upload)
+    {
+        base_mip_level = std::min(base_mip_level, texture.get_level_count() - 1);
+        w = std::max(1u, texture.get_width() >> base_mip_level);
+        h = std::max(1u, texture.get_height() >> base_mip_level);
+        mip_levels = texture.get_level_count() - base_mip_level;
+
+        // all mip levels are copied from one staging region, compressed images cannot be blitted to generate them
+        std::vector<unsigned char> staging_data;
+        std::vector<vk::BufferImageCopy> copy_regions;
+        for (uint32_t i = 0; i < mip_levels; ++i)
+        {
+            std::span<const unsigned char> level = texture.get_level(base_mip_level + i);
+            vk::BufferImageCopy copy_region{};
+            copy_region.bufferOffset = staging_data.size();
+            copy_region.bufferRowLength = 0;
+            copy_region.bufferImageHeight = 0;
+            copy_region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+            copy_region.imageSubresource.mipLevel = i;
+            copy_region.imageSubresource.baseArrayLayer = 0;
+            copy_region.imageSubresource.layerCount = 1;
+            copy_region.imageOffset = vk::Offset3D{0, 0, 0};
+            copy_region.imageExtent = vk::Extent3D{std::max(1u, uint32_t(w) >> i), std::max(1u, uint32_t(h) >> i), 1};
+            copy_regions.push_back(copy_region);
+            staging_data.insert(staging_data.end(), level.begin(), level.end());
+        }
+        byte_size = staging_data.size();
+        const UploadContext::StagingRegion staging = upload.stage(staging_data.data(), staging_data.size());
+
+        const vk::Format format = texture.get_format();
+        allocate_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, format, vk::SampleCountFlagBits::e1, AllocationClass::Texture);
+        transition_image_layout(upload.get_transfer_cb(), vk::ImageLayout::eTransferDstOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, vk::AccessFlagBits::eTransferWrite);
+        copy_buffer_to_image(upload.get_transfer_cb(), staging, copy_regions);
+        upload.transfer_ownership(image, layout, mip_levels);
+        transition_image_layout(upload.get_graphics_cb(), vk::ImageLayout::eShaderReadOnlyOptimal, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead);
 
         create_image_view(format, vk::ImageAspectFlagBits::eColor);
         create_sampler();
     }
 
-    void Image::create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, uint32_t width, uint32_t height, vk::SampleCountFlagBits sample_count)
+    void Image::create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, uint32_t width, uint32_t height, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class)
     {
         w = width;
         h = height;
-        create_image(queue_family_indices, usage, format, sample_count);
+        create_image(queue_family_indices, usage, format, sample_count, allocation_class);
     }
 
-    void Image::create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count)
+    void Image::create_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class)
     {
         mip_levels = mip_levels > 1 ? std::floor(std::log2(std::max(w, h))) + 1 : 1;
         if (mip_levels > 1) usage |= vk::ImageUsageFlagBits::eTransferSrc;
+        allocate_image(queue_family_indices, usage, format, sample_count, allocation_class);
+    }
+
+    void Image::allocate_image(const std::vector<uint32_t>& queue_family_indices, vk::ImageUsageFlags usage, vk::Format format, vk::SampleCountFlagBits sample_count, AllocationClass allocation_class)
+    {
         vk::ImageCreateInfo ici{};
         ici.sType = vk::StructureType::eImageCreateInfo;
         ici.imageType = vk::ImageType::e2D;
@@ -113,13 +134,13 @@ namespace ve
         ici.samples = sample_count;
         ici.flags = {};
 
-        VmaAllocationCreateInfo vaci{};
-        vaci.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-        vmaCreateImage(vmc.va, (VkImageCreateInfo*) (&ici), &vaci, (VkImage*) (&image), &vmaa, nullptr);
+        std::tie(image, vmaa) = vmc.memory_pools.create_image(ici, allocation_class);
     }
 
     void Image::create_image_view(vk::Format format, vk::ImageAspectFlags aspects)
     {
+        view_format = format;
+        view_aspects = aspects;
         vk::ImageViewCreateInfo ivci{};
         ivci.sType = vk::StructureType::eImageViewCreateInfo;
         ivci.image = image;
@@ -159,13 +180,22 @@ namespace ve
     {
         vmc.logical_device.get().destroySampler(sampler);
         vmc.logical_device.get().destroyImageView(view);
-        vmaDestroyImage(vmc.va, VkImage(image), vmaa);
+        vmc.memory_pools.destroy_image(image, vmaa);
     }
 
-    void Image::transition_image_layout(const VulkanCommandContext& vcc, vk::ImageLayout new_layout, vk::PipelineStageFlags src_stage_flags, vk::PipelineStageFlags dst_stage_flags, vk::AccessFlags src_access_flags, vk::AccessFlags dst_access_flags)
+    void Image::relocate(Defragmenter::Relocations& relocations)
     {
-        const vk::CommandBuffer& cb = vcc.begin(vcc.graphics_cb[0]);
+        auto it = relocations.images.find(image);
+        if (it == relocations.images.end()) return;
+        image = it->second;
+        const vk::ImageView old_view = view;
+        create_image_view(view_format, view_aspects);
+        relocations.image_views.emplace(old_view, view);
+        vmc.logical_device.get().destroyImageView(old_view);
+    }
 
+    void Image::transition_image_layout(const vk::CommandBuffer& cb, vk::ImageLayout new_layout, vk::PipelineStageFlags src_stage_flags, vk::PipelineStageFlags dst_stage_flags, vk::AccessFlags src_access_flags, vk::AccessFlags dst_access_flags)
+    {
         vk::ImageMemoryBarrier imb{};
         imb.sType = vk::StructureType::eImageMemoryBarrier;
         imb.oldLayout = layout;
@@ -185,7 +215,6 @@ namespace ve
         layout = new_layout;
 
         cb.pipelineBarrier(src_stage_flags, dst_stage_flags, {}, nullptr, nullptr, imb);
-        vcc.submit_graphics(cb, true);
     }
 
     vk::DeviceSize Image::get_byte_size() const
@@ -208,9 +237,8 @@ namespace ve
         return sampler;
     }
 
-    void Image::copy_buffer_to_image(const VulkanCommandContext& vcc, const Buffer& buffer)
+    void Image::copy_buffer_to_image(const vk::CommandBuffer& cb, const UploadContext::StagingRegion& staging)
     {
-        const vk::CommandBuffer& cb = vcc.begin(vcc.transfer_cb[0]);
         vk::BufferImageCopy copy_region{};
         copy_region.bufferOffset = 0;
         copy_region.bufferRowLength = 0;
@@ -221,15 +249,20 @@ namespace ve
         copy_region.imageSubresource.layerCount = 1;
         copy_region.imageOffset = vk::Offset3D{0, 0, 0};
         copy_region.imageExtent = vk::Extent3D{uint32_t(w), uint32_t(h), 1};
-
-        cb.copyBufferToImage(buffer.get(), image, layout, copy_region);
-        vcc.submit_transfer(cb, true);
+        copy_buffer_to_image(cb, staging, {copy_region});
     }
 
-    void Image::generate_mipmaps(const VulkanCommandContext& vcc)
+    void Image::copy_buffer_to_image(const vk::CommandBuffer& cb, const UploadContext::StagingRegion& staging, std::vector<vk::BufferImageCopy> copy_regions)
     {
-        const vk::CommandBuffer& cb = vcc.begin(vcc.graphics_cb[0]);
+        for (auto& copy_region: copy_regions)
+        {
+            copy_region.bufferOffset += staging.offset;
+        }
+        cb.copyBufferToImage(staging.buffer, image, layout, copy_regions);
+    }
 
+    void Image::generate_mipmaps(const vk::CommandBuffer& cb)
+    {
         vk::ImageMemoryBarrier imb{};
         imb.sType = vk::StructureType::eImageMemoryBarrier;
         imb.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
@@ -283,7 +316,5 @@ namespace ve
         imb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
         imb.dstAccessMask = vk::AccessFlagBits::eShaderRead;
         cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, nullptr, nullptr, imb);
-
-        vcc.submit_graphics(cb, true);
     }
 }// namespace ve
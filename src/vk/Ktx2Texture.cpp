@@ -0,0 +1,233 @@
+#include "vk/Ktx2Texture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace ve
+{
+    namespace
+    {
+        constexpr unsigned char ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+        // the 64 bit supercompression global data fields are split into 32 bit halves, as they are not 8 byte aligned in the file
+        struct Header {
+            uint32_t vk_format;
+            uint32_t type_size;
+            uint32_t pixel_width;
+            uint32_t pixel_height;
+            uint32_t pixel_depth;
+            uint32_t layer_count;
+            uint32_t face_count;
+            uint32_t level_count;
+            uint32_t supercompression_scheme;
+            uint32_t dfd_byte_offset;
+            uint32_t dfd_byte_length;
+            uint32_t kvd_byte_offset;
+            uint32_t kvd_byte_length;
+            uint32_t sgd_byte_offset_lo;
+            uint32_t sgd_byte_offset_hi;
+            uint32_t sgd_byte_length_lo;
+            uint32_t sgd_byte_length_hi;
+        };
+        static_assert(sizeof(Header) == 68, "KTX2 header must not contain padding");
+
+        struct LevelIndex {
+            uint64_t byte_offset;
+            uint64_t byte_length;
+            uint64_t uncompressed_byte_length;
+        };
+
+        // color models and channel ids of the Khronos data format specification
+        constexpr uint32_t khr_df_model_bc1a = 128;
+        constexpr uint32_t khr_df_model_bc3 = 130;
+        constexpr uint32_t khr_df_model_bc5 = 132;
+        constexpr uint32_t khr_df_model_bc7 = 134;
+        constexpr uint32_t khr_df_channel_color = 0;
+        constexpr uint32_t khr_df_channel_green = 1;
+        constexpr uint32_t khr_df_channel_alpha = 15;
+
+        bool is_srgb(vk::Format format)
+        {
+            return format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc3SrgbBlock || format == vk::Format::eBc7SrgbBlock;
+        }
+
+        // basic data format descriptor of a block compressed format
+        std::vector<uint32_t> create_dfd(vk::Format format)
+        {
+            uint32_t color_model;
+            std::vector<std::pair<uint32_t, uint32_t>> samples;// channel id and bit offset of 64 bit samples
+            switch (format)
+            {
+                case vk::Format::eBc1RgbUnormBlock:
+                case vk::Format::eBc1RgbSrgbBlock:
+                    color_model = khr_df_model_bc1a;
+                    samples = {{khr_df_channel_color, 0}};
+                    break;
+                case vk::Format::eBc3UnormBlock:
+                case vk::Format::eBc3SrgbBlock:
+                    color_model = khr_df_model_bc3;
+                    samples = {{khr_df_channel_alpha, 0}, {khr_df_channel_color, 64}};
+                    break;
+                case vk::Format::eBc5UnormBlock:
+                    color_model = khr_df_model_bc5;
+                    samples = {{khr_df_channel_color, 0}, {khr_df_channel_green, 64}};
+                    break;
+                default:
+                    color_model = khr_df_model_bc7;
+                    samples = {{khr_df_channel_color, 0}};
+            }
+            const uint32_t sample_bits = color_model == khr_df_model_bc7 ? 128 : 64;
+            const uint32_t block_size = 24 + 16 * samples.size();
+            std::vector<uint32_t> dfd;
+            dfd.push_back(4 + block_size);
+            // vendor id and descriptor type 0 (Khronos basic descriptor block), version 2
+            dfd.push_back(0);
+            dfd.push_back(2 | (block_size << 16));
+            // BT.709 primaries, linear or sRGB transfer function, straight alpha
+            dfd.push_back(color_model | (1 << 8) | ((is_srgb(format) ? 2 : 1) << 16));
+            // 4x4 texel blocks
+            dfd.push_back(3 | (3 << 8));
+            dfd.push_back(Ktx2Texture::get_block_size(format));
+            dfd.push_back(0);
+            for (const auto& sample: samples)
+            {
+                dfd.push_back(sample.second | ((sample_bits - 1) << 16) | (sample.first << 24));
+                dfd.push_back(0);
+                dfd.push_back(0);
+                dfd.push_back(0xFFFFFFFF);
+            }
+            return dfd;
+        }
+
+        uint64_t align(uint64_t offset, uint64_t alignment)
+        {
+            return (offset + alignment - 1) / alignment * alignment;
+        }
+    }// namespace
+
+    Ktx2Texture::Ktx2Texture(const std::string& path) : file(path)
+    {
+        if (!file.is_open()) return;
+        data = std::span<const unsigned char>(file.data(), file.size());
+        if (!parse()) data = {};
+    }
+
+    Ktx2Texture::Ktx2Texture(vk::Format format, uint32_t width, uint32_t height, const std::vector<std::vector<unsigned char>>& levels)
+    {
+        const std::vector<uint32_t> dfd = create_dfd(format);
+        Header header{};
+        header.vk_format = uint32_t(VkFormat(format));
+        header.type_size = 1;
+        header.pixel_width = width;
+        header.pixel_height = height;
+        header.face_count = 1;
+        header.level_count = levels.size();
+        header.dfd_byte_offset = sizeof(ktx2_identifier) + sizeof(Header) + levels.size() * sizeof(LevelIndex);
+        header.dfd_byte_length = dfd.size() * sizeof(uint32_t);
+
+        // the mip levels are stored from the smallest to the largest one, aligned to the block size
+        std::vector<LevelIndex> level_index(levels.size());
+        uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+        for (uint32_t i = levels.size(); i-- > 0;)
+        {
+            offset = align(offset, get_block_size(format));
+            level_index[i] = {offset, levels[i].size(), levels[i].size()};
+            offset += levels[i].size();
+        }
+
+        memory.resize(offset, 0);
+        memcpy(memory.data(), ktx2_identifier, sizeof(ktx2_identifier));
+        memcpy(memory.data() + sizeof(ktx2_identifier), &header, sizeof(Header));
+        memcpy(memory.data() + sizeof(ktx2_identifier) + sizeof(Header), level_index.data(), level_index.size() * sizeof(LevelIndex));
+        memcpy(memory.data() + header.dfd_byte_offset, dfd.data(), header.dfd_byte_length);
+        for (uint32_t i = 0; i < levels.size(); ++i) memcpy(memory.data() + level_index[i].byte_offset, levels[i].data(), levels[i].size());
+        data = std::span<const unsigned char>(memory);
+        if (!parse()) data = {};
+    }
+
+    bool Ktx2Texture::write(const std::string& path) const
+    {
+        if (!is_valid()) return false;
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        out.write(reinterpret_cast<const char*>(data.data()), data.size());
+        return out.good();
+    }
+
+    bool Ktx2Texture::is_valid() const
+    {
+        return !data.empty();
+    }
+
+    vk::Format Ktx2Texture::get_format() const
+    {
+        return format;
+    }
+
+    uint32_t Ktx2Texture::get_width() const
+    {
+        return width;
+    }
+
+    uint32_t Ktx2Texture::get_height() const
+    {
+        return height;
+    }
+
+    uint32_t Ktx2Texture::get_level_count() const
+    {
+        return levels.size();
+    }
+
+    std::span<const unsigned char> Ktx2Texture::get_level(uint32_t level) const
+    {
+        return data.subspan(levels[level].offset, levels[level].size);
+    }
+
+    uint32_t Ktx2Texture::get_block_size(vk::Format format)
+    {
+        switch (format)
+        {
+            case vk::Format::eBc1RgbUnormBlock:
+            case vk::Format::eBc1RgbSrgbBlock:
+                return 8;
+            case vk::Format::eBc3UnormBlock:
+            case vk::Format::eBc3SrgbBlock:
+            case vk::Format::eBc5UnormBlock:
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+    bool Ktx2Texture::parse()
+    {
+        if (data.size() < sizeof(ktx2_identifier) + sizeof(Header) || memcmp(data.data(), ktx2_identifier, sizeof(ktx2_identifier)) != 0) return false;
+        Header header;
+        memcpy(&header, data.data() + sizeof(ktx2_identifier), sizeof(Header));
+        format = vk::Format(header.vk_format);
+        width = header.pixel_width;
+        height = header.pixel_height;
+        const uint32_t block_size = get_block_size(format);
+        // only single 2D images in the formats that are written by the TextureCompressor are supported
+        if (block_size == 0 || header.supercompression_scheme != 0 || header.pixel_depth > 1 || header.layer_count > 1 || header.face_count != 1 || width == 0 || height == 0) return false;
+        const uint32_t level_count = std::max(1u, header.level_count);
+        if (data.size() < sizeof(ktx2_identifier) + sizeof(Header) + level_count * sizeof(LevelIndex)) return false;
+
+        levels.clear();
+        for (uint32_t i = 0; i < level_count; ++i)
+        {
+            LevelIndex level_index;
+            memcpy(&level_index, data.data() + sizeof(ktx2_identifier) + sizeof(Header) + i * sizeof(LevelIndex), sizeof(LevelIndex));
+            const uint64_t level_width = std::max(1u, width >> i);
+            const uint64_t level_height = std::max(1u, height >> i);
+            const uint64_t expected_size = ((level_width + 3) / 4) * ((level_height + 3) / 4) * block_size;
+            if (level_index.byte_length != expected_size || level_index.byte_offset + level_index.byte_length > data.size()) return false;
+            levels.push_back({level_index.byte_offset, level_index.byte_length});
+        }
+        return true;
+    }
+}// namespace ve
@@ -30,6 +30,19 @@ namespace ve
         vk::PhysicalDeviceFeatures device_features{};
         device_features.samplerAnisotropy = VK_TRUE;
         device_features.sampleRateShading = VK_TRUE;
+        // compressed textures are used if available
+        device_features.textureCompressionBC = p_device.get().getFeatures().textureCompressionBC;
+        vk::PhysicalDeviceVulkan12Features device_features_12{};
+        device_features_12.sType = vk::StructureType::ePhysicalDeviceVulkan12Features;
+        device_features_12.timelineSemaphore = VK_TRUE;
+        // bindless textures are used if available
+        if (p_device.supports_descriptor_indexing())
+        {
+            device_features_12.runtimeDescriptorArray = VK_TRUE;
+            device_features_12.descriptorBindingPartiallyBound = VK_TRUE;
+            device_features_12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            device_features_12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        }
         vk::DeviceCreateInfo dci{};
         dci.sType = vk::StructureType::eDeviceCreateInfo;
         dci.queueCreateInfoCount = qci_s.size();
@@ -37,12 +50,17 @@ namespace ve
         dci.enabledExtensionCount = p_device.get_extensions().size();
         dci.ppEnabledExtensionNames = p_device.get_extensions().data();
         dci.pEnabledFeatures = &device_features;
+        dci.pNext = &device_features_12;
 
         device = p_device.get().createDevice(dci);
         queues.emplace(QueueIndex::Graphics, device.getQueue(indices.graphics, 0));
         queues.emplace(QueueIndex::Compute, device.getQueue(indices.compute, 0));
         queues.emplace(QueueIndex::Transfer, device.getQueue(indices.transfer, 0));
         queues.emplace(QueueIndex::Present, device.getQueue(indices.present, 0));
+        if (p_device.is_extension_enabled(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME))
+        {
+            cmd_push_descriptor_set = reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(device.getProcAddr("vkCmdPushDescriptorSetKHR"));
+        }
     }
 
     void LogicalDevice::self_destruct()
@@ -54,4 +72,15 @@ namespace ve
     {
         return device;
     }
+
+    bool LogicalDevice::supports_push_descriptors() const
+    {
+        return cmd_push_descriptor_set != nullptr;
+    }
+
+    void LogicalDevice::push_descriptor_set(const vk::CommandBuffer& cb, vk::PipelineBindPoint bind_point, vk::PipelineLayout layout, uint32_t set, uint32_t write_count, const vk::WriteDescriptorSet* writes) const
+    {
+        VE_ASSERT(cmd_push_descriptor_set != nullptr, "Push descriptors are not supported!\n");
+        cmd_push_descriptor_set(cb, VkPipelineBindPoint(bind_point), layout, set, write_count, reinterpret_cast<const VkWriteDescriptorSet*>(writes));
+    }
 }// namespace ve
@@ -0,0 +1,276 @@
+#include "vk/MemoryPools.hpp"
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        struct ClassConfig {
+            const char* name;
+            VmaMemoryUsage usage;
+            // host access and allocation strategy
+            VmaAllocationCreateFlags flags;
+            VmaPoolCreateFlags pool_flags;
+            // 0 if the class is not pooled
+            vk::DeviceSize block_size;
+            // allocations of at least this size get their own device memory
+            vk::DeviceSize dedicated_size;
+            // resources in the pool can be moved by the defragmentation
+            bool movable;
+        };
+
+        constexpr vk::DeviceSize mib = 1024 * 1024;
+
+        // indexed by AllocationClass
+        const std::array<ClassConfig, allocation_class_count> class_configs = {{
+                // geometry heap blocks live as long as the scene, only oversized blocks for huge models are dedicated
+                {"Geometry", VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT, 0, 256 * mib, 128 * mib, true},
+                // textures are freed in arbitrary order, TLSF keeps the fragmentation of the blocks low
+                {"Texture", VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_STRATEGY_MIN_MEMORY_BIT, 0, 256 * mib, 64 * mib, true},
+                // uniform buffers are created once per frame in flight, a linear pool allocates them in constant time but cannot be defragmented
+                {"Uniform", VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT, VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT, 4 * mib, 4 * mib, false},
+                // the staging ring and the buffers of oversized uploads are large enough to be dedicated
+                {"Staging", VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_STRATEGY_MIN_TIME_BIT, 0, 0, 0, false},
+                // attachments are freed with the swapchain, dedicated memory lets the driver reuse it right away
+                {"Attachment", VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, 0, 0, 0, false},
+        }};
+
+        // memory type of a representative resource of the class
+        VkResult find_memory_type(VmaAllocator va, AllocationClass allocation_class, const VmaAllocationCreateInfo& vaci, uint32_t& memory_type)
+        {
+            if (allocation_class == AllocationClass::Texture)
+            {
+                vk::ImageCreateInfo ici{};
+                ici.sType = vk::StructureType::eImageCreateInfo;
+                ici.imageType = vk::ImageType::e2D;
+                ici.extent = vk::Extent3D{1024, 1024, 1};
+                ici.mipLevels = 1;
+                ici.arrayLayers = 1;
+                ici.format = vk::Format::eR8G8B8A8Srgb;
+                ici.tiling = vk::ImageTiling::eOptimal;
+                ici.initialLayout = vk::ImageLayout::eUndefined;
+                ici.usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled;
+                ici.sharingMode = vk::SharingMode::eExclusive;
+                ici.samples = vk::SampleCountFlagBits::e1;
+                return vmaFindMemoryTypeIndexForImageInfo(va, (VkImageCreateInfo*) (&ici), &vaci, &memory_type);
+            }
+            vk::BufferCreateInfo bci{};
+            bci.sType = vk::StructureType::eBufferCreateInfo;
+            bci.size = 64 * 1024;
+            bci.usage = allocation_class == AllocationClass::Geometry ? vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst : vk::BufferUsageFlags(vk::BufferUsageFlagBits::eUniformBuffer);
+            bci.sharingMode = vk::SharingMode::eExclusive;
+            return vmaFindMemoryTypeIndexForBufferInfo(va, (VkBufferCreateInfo*) (&bci), &vaci, &memory_type);
+        }
+    }// namespace
+
+    MemoryPools::MemoryPools(const LogicalDevice& logical_device, VmaAllocator va) : logical_device(logical_device), va(va)
+    {
+        for (uint32_t i = 0; i < allocation_class_count; ++i)
+        {
+            const ClassConfig& config = class_configs[i];
+            if (config.block_size == 0) continue;
+            VmaAllocationCreateInfo vaci{};
+            vaci.usage = config.usage;
+            vaci.flags = config.flags;
+            VE_CHECK(vk::Result(find_memory_type(va, AllocationClass(i), vaci, memory_types[i])), "Failed to find memory type for memory pool!");
+            VmaPoolCreateInfo vpci{};
+            vpci.memoryTypeIndex = memory_types[i];
+            vpci.flags = config.pool_flags;
+            vpci.blockSize = config.block_size;
+            VE_CHECK(vk::Result(vmaCreatePool(va, &vpci, &pools[i])), "Failed to create memory pool!");
+            vmaSetPoolName(va, pools[i], config.name);
+            VE_LOG_CONSOLE(VE_INFO, "Created " << config.name << " memory pool with " << config.block_size / mib << " MiB blocks of memory type " << memory_types[i] << "\n");
+        }
+    }
+
+    std::pair<vk::Buffer, VmaAllocation> MemoryPools::create_buffer(const vk::BufferCreateInfo& bci, AllocationClass allocation_class, VmaAllocationCreateFlags flags, VmaAllocationInfo* vai) const
+    {
+        const ClassConfig& config = class_configs[uint32_t(allocation_class)];
+        vk::BufferCreateInfo final_bci = bci;
+        // the content of movable buffers is copied to their new place
+        if (config.movable) final_bci.usage |= vk::BufferUsageFlagBits::eTransferSrc | vk::BufferUsageFlagBits::eTransferDst;
+        vk::Buffer buffer = logical_device.get().createBuffer(final_bci);
+        vk::BufferMemoryRequirementsInfo2 bmri{};
+        bmri.sType = vk::StructureType::eBufferMemoryRequirementsInfo2;
+        bmri.buffer = buffer;
+        const auto requirements = logical_device.get().getBufferMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(bmri);
+        const VmaAllocationCreateInfo vaci = get_allocation_create_info(allocation_class, requirements.get<vk::MemoryRequirements2>().memoryRequirements, requirements.get<vk::MemoryDedicatedRequirements>().requiresDedicatedAllocation, flags);
+        VmaAllocation vmaa;
+        VE_CHECK(vk::Result(vmaAllocateMemoryForBuffer(va, buffer, &vaci, &vmaa, vai)), "Failed to allocate buffer memory!");
+        VE_CHECK(vk::Result(vmaBindBufferMemory(va, vmaa, buffer)), "Failed to bind buffer memory!");
+        // the queue family indices of concurrent buffers could not be kept, so only exclusive buffers are movable
+        std::optional<MovableResource> movable;
+        if (config.movable && vaci.pool != VK_NULL_HANDLE && final_bci.sharingMode == vk::SharingMode::eExclusive)
+        {
+            movable = MovableResource{};
+            movable->buffer = buffer;
+            movable->bci = final_bci;
+            movable->bci.pNext = nullptr;
+            movable->bci.queueFamilyIndexCount = 0;
+            movable->bci.pQueueFamilyIndices = nullptr;
+        }
+        add_record(vmaa, allocation_class, movable);
+        return std::make_pair(buffer, vmaa);
+    }
+
+    std::pair<vk::Image, VmaAllocation> MemoryPools::create_image(const vk::ImageCreateInfo& ici, AllocationClass allocation_class) const
+    {
+        const ClassConfig& config = class_configs[uint32_t(allocation_class)];
+        vk::ImageCreateInfo final_ici = ici;
+        if (config.movable) final_ici.usage |= vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst;
+        vk::Image image = logical_device.get().createImage(final_ici);
+        vk::ImageMemoryRequirementsInfo2 imri{};
+        imri.sType = vk::StructureType::eImageMemoryRequirementsInfo2;
+        imri.image = image;
+        const auto requirements = logical_device.get().getImageMemoryRequirements2<vk::MemoryRequirements2, vk::MemoryDedicatedRequirements>(imri);
+        const VmaAllocationCreateInfo vaci = get_allocation_create_info(allocation_class, requirements.get<vk::MemoryRequirements2>().memoryRequirements, requirements.get<vk::MemoryDedicatedRequirements>().requiresDedicatedAllocation, 0);
+        VmaAllocation vmaa;
+        VE_CHECK(vk::Result(vmaAllocateMemoryForImage(va, image, &vaci, &vmaa, nullptr)), "Failed to allocate image memory!");
+        VE_CHECK(vk::Result(vmaBindImageMemory(va, vmaa, image)), "Failed to bind image memory!");
+        std::optional<MovableResource> movable;
+        if (config.movable && vaci.pool != VK_NULL_HANDLE && final_ici.sharingMode == vk::SharingMode::eExclusive)
+        {
+            movable = MovableResource{};
+            movable->image = image;
+            movable->ici = final_ici;
+            movable->ici.pNext = nullptr;
+            movable->ici.queueFamilyIndexCount = 0;
+            movable->ici.pQueueFamilyIndices = nullptr;
+        }
+        add_record(vmaa, allocation_class, movable);
+        return std::make_pair(image, vmaa);
+    }
+
+    void MemoryPools::destroy_buffer(vk::Buffer buffer, VmaAllocation vmaa) const
+    {
+        remove_record(vmaa);
+        vmaDestroyBuffer(va, buffer, vmaa);
+    }
+
+    void MemoryPools::destroy_image(vk::Image image, VmaAllocation vmaa) const
+    {
+        remove_record(vmaa);
+        vmaDestroyImage(va, image, vmaa);
+    }
+
+    VmaPool MemoryPools::get_movable_pool(AllocationClass allocation_class) const
+    {
+        return class_configs[uint32_t(allocation_class)].movable ? pools[uint32_t(allocation_class)] : VK_NULL_HANDLE;
+    }
+
+    vk::DeviceSize MemoryPools::get_block_size(AllocationClass allocation_class) const
+    {
+        return class_configs[uint32_t(allocation_class)].block_size;
+    }
+
+    std::optional<MemoryPools::MovableResource> MemoryPools::get_movable_resource(VmaAllocation vmaa) const
+    {
+        std::lock_guard<std::mutex> lock(records_mutex);
+        auto it = records.find(vmaa);
+        if (it == records.end()) return std::nullopt;
+        return it->second.movable;
+    }
+
+    void MemoryPools::set_movable_handle(VmaAllocation vmaa, vk::Buffer buffer) const
+    {
+        std::lock_guard<std::mutex> lock(records_mutex);
+        records.at(vmaa).movable.value().buffer = buffer;
+    }
+
+    void MemoryPools::set_movable_handle(VmaAllocation vmaa, vk::Image image) const
+    {
+        std::lock_guard<std::mutex> lock(records_mutex);
+        records.at(vmaa).movable.value().image = image;
+    }
+
+    MemoryPools::Stats MemoryPools::get_stats() const
+    {
+        Stats stats;
+        {
+            std::lock_guard<std::mutex> lock(records_mutex);
+            stats.classes = class_usage;
+        }
+        const VkPhysicalDeviceMemoryProperties* memory_properties;
+        vmaGetMemoryProperties(va, &memory_properties);
+        std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets;
+        vmaGetHeapBudgets(va, budgets.data());
+        for (uint32_t i = 0; i < memory_properties->memoryHeapCount; ++i)
+        {
+            HeapBudget heap;
+            heap.device_local = memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+            heap.block_bytes = budgets[i].statistics.blockBytes;
+            heap.allocation_bytes = budgets[i].statistics.allocationBytes;
+            heap.usage = budgets[i].usage;
+            heap.budget = budgets[i].budget;
+            stats.heaps.push_back(heap);
+        }
+        return stats;
+    }
+
+    void MemoryPools::log_stats() const
+    {
+        const Stats stats = get_stats();
+        for (uint32_t i = 0; i < allocation_class_count; ++i)
+        {
+            VE_LOG_CONSOLE(VE_INFO, class_configs[i].name << " memory: " << stats.classes[i].allocation_count << " allocations, " << stats.classes[i].bytes / mib << " MiB\n");
+        }
+        for (uint32_t i = 0; i < stats.heaps.size(); ++i)
+        {
+            const HeapBudget& heap = stats.heaps[i];
+            VE_LOG_CONSOLE(VE_INFO, "Memory heap " << i << (heap.device_local ? " (device local)" : "") << ": " << heap.allocation_bytes / mib << " MiB used of " << heap.block_bytes / mib << " MiB allocated, process usage " << heap.usage / mib << " MiB of " << heap.budget / mib << " MiB budget\n");
+            if (heap.usage > heap.budget / 10 * 9) VE_LOG_CONSOLE(VE_WARN, "Memory heap " << i << " is close to its budget, the driver may start evicting memory\n");
+        }
+    }
+
+    void MemoryPools::self_destruct()
+    {
+        for (VmaPool& pool: pools)
+        {
+            if (pool != VK_NULL_HANDLE) vmaDestroyPool(va, pool);
+            pool = VK_NULL_HANDLE;
+        }
+        records.clear();
+        class_usage = {};
+    }
+
+    VmaAllocationCreateInfo MemoryPools::get_allocation_create_info(AllocationClass allocation_class, const vk::MemoryRequirements& requirements, bool requires_dedicated, VmaAllocationCreateFlags flags) const
+    {
+        const uint32_t i = uint32_t(allocation_class);
+        const ClassConfig& config = class_configs[i];
+        VmaAllocationCreateInfo vaci{};
+        vaci.usage = config.usage;
+        vaci.flags = config.flags | flags;
+        // pools with a fixed block size cannot hold dedicated allocations, those are made by the default allocator
+        if (requires_dedicated || requirements.size >= config.dedicated_size)
+        {
+            vaci.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+            return vaci;
+        }
+        // VMA does not check the memory type bits of the resource against the memory type of a pool
+        if (pools[i] != VK_NULL_HANDLE && (requirements.memoryTypeBits & (1u << memory_types[i]))) vaci.pool = pools[i];
+        return vaci;
+    }
+
+    void MemoryPools::add_record(VmaAllocation vmaa, AllocationClass allocation_class, std::optional<MovableResource> movable) const
+    {
+        VmaAllocationInfo vai;
+        vmaGetAllocationInfo(va, vmaa, &vai);
+        std::lock_guard<std::mutex> lock(records_mutex);
+        records.emplace(vmaa, AllocationRecord{allocation_class, vai.size, movable});
+        ClassUsage& usage = class_usage[uint32_t(allocation_class)];
+        ++usage.allocation_count;
+        usage.bytes += vai.size;
+    }
+
+    void MemoryPools::remove_record(VmaAllocation vmaa) const
+    {
+        std::lock_guard<std::mutex> lock(records_mutex);
+        auto it = records.find(vmaa);
+        if (it == records.end()) return;
+        ClassUsage& usage = class_usage[uint32_t(it->second.allocation_class)];
+        --usage.allocation_count;
+        usage.bytes -= it->second.size;
+        records.erase(it);
+    }
+}// namespace ve
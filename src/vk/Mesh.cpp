@@ -2,24 +2,38 @@
 
 namespace ve
 {
-    Mesh::Mesh(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const Material* material, uint32_t idx_offset, uint32_t idx_count) : mat(material), index_offset(idx_offset), index_count(idx_count)
+    Mesh::Mesh(const VulkanMainContext& vmc, const VulkanCommandContext& vcc, const Material* material, uint32_t idx_offset, uint32_t idx_count, int32_t vtx_offset, vk::IndexType idx_type) : index_offset(idx_offset), index_count(idx_count), vertex_offset(vtx_offset), index_type(idx_type), mat(material)
     {}
 
     void Mesh::self_destruct()
     {}
 
-    void Mesh::add_set_bindings(DescriptorSetHandler& dsh)
+    void Mesh::add_material_set(DescriptorSetHandler& material_dsh, std::unordered_map<const Material*, uint32_t>& material_sets, const Image& fallback_texture)
     {
-        descriptor_set_indices.push_back(dsh.new_set());
-        if (mat != nullptr)
+        auto it = material_sets.find(mat);
+        if (it == material_sets.end())
         {
-            if (mat->base_texture != nullptr) dsh.add_descriptor(1, *(mat->base_texture));
+            const uint32_t set = material_dsh.new_set();
+            material_dsh.add_descriptor(0, (mat != nullptr && mat->base_texture != nullptr) ? *(mat->base_texture) : fallback_texture);
+            it = material_sets.emplace(mat, set).first;
         }
+        material_set = it->second;
     }
 
-    void Mesh::draw(vk::CommandBuffer& cb, const vk::PipelineLayout layout, const std::vector<vk::DescriptorSet>& sets, uint32_t current_frame)
+    void Mesh::add_material(BindlessTable& bindless_table)
     {
-        cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, sets[descriptor_set_indices[current_frame]], {});
-        cb.drawIndexed(index_count, 1, index_offset, 0, 0);
+        material_idx = bindless_table.add_material(mat);
+    }
+
+    void Mesh::draw(vk::CommandBuffer& cb, const vk::PipelineLayout layout, DescriptorSetHandler& material_dsh)
+    {
+        if (material_idx.has_value()) cb.pushConstants(layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, offsetof(PushConstants, material_idx), sizeof(uint32_t), &material_idx.value());
+        else if (material_set.has_value()) material_dsh.bind(cb, layout, DescriptorSetFrequency::PerMaterial, material_set.value());
+        cb.drawIndexed(index_count, 1, index_offset, vertex_offset, 0);
+    }
+
+    vk::IndexType Mesh::get_index_type() const
+    {
+        return index_type;
     }
 }// namespace ve
@@ -0,0 +1,151 @@
+#include "vk/MeshCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <glm/gtc/type_ptr.hpp>
+#include <sstream>
+#include <thread>
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        constexpr char cache_magic[4] = {'V', 'E', 'M', 'C'};
+
+        uint64_t align_offset(uint64_t offset)
+        {
+            return (offset + 15) & ~uint64_t(15);
+        }
+
+        // true if count elements of element_size bytes starting at offset lie within a file of file_size bytes, cannot overflow
+        bool fits_in_file(uint64_t offset, uint64_t count, uint64_t element_size, uint64_t file_size)
+        {
+            if (offset > file_size) return false;
+            return element_size == 0 || count <= (file_size - offset) / element_size;
+        }
+    }// namespace
+
+    uint64_t MeshCache::hash(const unsigned char* data, std::size_t size)
+    {
+        // FNV-1a over 64 bit words with an additional shift to mix the high bits back into the low bits
+        constexpr uint64_t prime = 1099511628211ull;
+        uint64_t h = 14695981039346656037ull ^ size;
+        std::size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(uint64_t));
+            h = (h ^ word) * prime;
+            h ^= h >> 32;
+        }
+        for (; i < size; ++i)
+        {
+            h = (h ^ data[i]) * prime;
+        }
+        return h;
+    }
+
+    bool MeshCache::load(const std::string& path, uint64_t content_hash, uint64_t options_hash, ModelData& model_data)
+    {
+        MappedFile cache_file(get_cache_path(path, content_hash, options_hash));
+        if (!cache_file.is_open() || cache_file.size() < sizeof(Header)) return false;
+        Header header;
+        memcpy(&header, cache_file.data(), sizeof(Header));
+        if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != version || header.content_hash != content_hash || header.options_hash != options_hash || header.vertex_size != get_vertex_size(header.vertex_format)) return false;
+        // corrupt or foreign entries are misses, the sections are read directly from the mapping
+        if (!fits_in_file(header.meshes_offset, header.mesh_count, sizeof(ModelData::MeshData), cache_file.size()) || !fits_in_file(header.vertices_offset, header.vertex_count, header.vertex_size, cache_file.size()) || !fits_in_file(header.indices_offset, header.index_data_size, 1, cache_file.size()) || !fits_in_file(header.materials_offset, header.material_count, sizeof(ModelData::MaterialFactors), cache_file.size())) return false;
+
+        model_data.meshes.resize(header.mesh_count);
+        memcpy(model_data.meshes.data(), cache_file.data() + header.meshes_offset, header.mesh_count * sizeof(ModelData::MeshData));
+        model_data.material_factors.resize(header.material_count);
+        memcpy(model_data.material_factors.data(), cache_file.data() + header.materials_offset, header.material_count * sizeof(ModelData::MaterialFactors));
+        model_data.vertex_format = header.vertex_format;
+        model_data.position_offset = glm::make_vec3(header.position_offset);
+        model_data.position_scale = glm::make_vec3(header.position_scale);
+        model_data.cached_vertex_data = std::span<const unsigned char>(cache_file.data() + header.vertices_offset, header.vertex_count * header.vertex_size);
+        model_data.cached_index_data = std::span<const unsigned char>(cache_file.data() + header.indices_offset, header.index_data_size);
+        model_data.cache_file = std::move(cache_file);
+        // without textures the materials are completely described by their cached factors
+        model_data.requires_gltf = header.has_textures;
+        VE_LOG_CONSOLE(VE_INFO, "Loaded cached mesh data of \"" << path << "\"\n");
+        return true;
+    }
+
+    void MeshCache::store(const std::string& path, uint64_t content_hash, uint64_t options_hash, const ModelData& model_data)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(cache_dir, ec);
+        // entries of older versions of the same file are stale now, the entries of this version with other options are still valid
+        const std::string prefix = std::filesystem::path(get_cache_prefix(path)).filename().string();
+        std::stringstream version_prefix;
+        version_prefix << prefix << std::hex << content_hash << "_";
+        for (const auto& entry: std::filesystem::directory_iterator(cache_dir, ec))
+        {
+            const std::string filename = entry.path().filename().string();
+            if (filename.starts_with(prefix) && !filename.starts_with(version_prefix.str()) && entry.path().extension() == ".vemesh") std::filesystem::remove(entry.path(), ec);
+        }
+
+        std::span<const unsigned char> vertex_data = model_data.get_vertex_data();
+        std::span<const unsigned char> index_data = model_data.get_index_data();
+        Header header{};
+        memcpy(header.magic, cache_magic, sizeof(cache_magic));
+        header.version = version;
+        header.content_hash = content_hash;
+        header.options_hash = options_hash;
+        header.vertex_format = model_data.vertex_format;
+        header.vertex_size = get_vertex_size(model_data.vertex_format);
+        header.has_textures = !model_data.gltf_model.textures.empty();
+        memcpy(header.position_offset, glm::value_ptr(model_data.position_offset), sizeof(header.position_offset));
+        memcpy(header.position_scale, glm::value_ptr(model_data.position_scale), sizeof(header.position_scale));
+        header.mesh_count = model_data.meshes.size();
+        header.vertex_count = vertex_data.size() / header.vertex_size;
+        header.index_data_size = index_data.size();
+        header.meshes_offset = align_offset(sizeof(Header));
+        header.vertices_offset = align_offset(header.meshes_offset + header.mesh_count * sizeof(ModelData::MeshData));
+        header.indices_offset = align_offset(header.vertices_offset + header.vertex_count * header.vertex_size);
+        header.material_count = model_data.material_factors.size();
+        header.materials_offset = align_offset(header.indices_offset + header.index_data_size);
+
+        // write to a temporary file first so that concurrent loaders never map a partially written entry
+        const std::string cache_path = get_cache_path(path, content_hash, options_hash);
+        std::stringstream tmp_path;
+        tmp_path << cache_path << ".tmp" << std::this_thread::get_id();
+        {
+            std::ofstream file(tmp_path.str(), std::ios::binary);
+            if (!file.is_open())
+            {
+                VE_LOG_CONSOLE(VE_WARN, VE_C_YELLOW << "Failed to write mesh cache \"" << cache_path << "\"\n");
+                return;
+            }
+            auto write_at = [&](uint64_t offset, const void* data, uint64_t size) -> void {
+                file.seekp(offset);
+                file.write(reinterpret_cast<const char*>(data), size);
+            };
+            write_at(0, &header, sizeof(Header));
+            write_at(header.meshes_offset, model_data.meshes.data(), header.mesh_count * sizeof(ModelData::MeshData));
+            write_at(header.vertices_offset, vertex_data.data(), vertex_data.size());
+            write_at(header.indices_offset, index_data.data(), index_data.size());
+            write_at(header.materials_offset, model_data.material_factors.data(), header.material_count * sizeof(ModelData::MaterialFactors));
+        }
+        std::filesystem::rename(tmp_path.str(), cache_path, ec);
+        if (ec) std::filesystem::remove(tmp_path.str(), ec);
+    }
+
+    std::string MeshCache::get_cache_prefix(const std::string& path)
+    {
+        // the hash of the path keeps models with the same file name in different directories apart
+        std::stringstream ss;
+        ss << cache_dir << std::filesystem::path(path).stem().string() << "_" << std::hex << hash(reinterpret_cast<const unsigned char*>(path.data()), path.size()) << "_";
+        return ss.str();
+    }
+
+    std::string MeshCache::get_cache_path(const std::string& path, uint64_t content_hash, uint64_t options_hash)
+    {
+        std::stringstream ss;
+        ss << get_cache_prefix(path) << std::hex << content_hash << "_" << options_hash << ".vemesh";
+        return ss.str();
+    }
+}// namespace ve
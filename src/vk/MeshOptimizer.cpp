@@ -0,0 +1,410 @@
+#include "vk/MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        // scoring constants of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+        constexpr float cache_decay_power = 1.5f;
+        constexpr float last_triangle_score = 0.75f;
+        constexpr float valence_boost_scale = 2.0f;
+        constexpr float valence_boost_power = 0.5f;
+
+        float get_vertex_score(int32_t cache_position, uint32_t remaining_triangles, uint32_t cache_size)
+        {
+            // vertices without remaining triangles are never needed again
+            if (remaining_triangles == 0) return -1.0f;
+            float score = 0.0f;
+            if (cache_position >= 0)
+            {
+                // the vertices of the last triangle get a fixed score to not favor any order within the triangle
+                if (cache_position < 3) score = last_triangle_score;
+                else score = std::pow(1.0f - float(cache_position - 3) / float(cache_size - 3), cache_decay_power);
+            }
+            // boost vertices with few remaining triangles to get rid of them quickly
+            score += valence_boost_scale * std::pow(float(remaining_triangles), -valence_boost_power);
+            return score;
+        }
+    }// namespace
+
+    void MeshOptimizer::optimize(ModelData& model_data, const ImportOptions& options)
+    {
+        std::vector<uint32_t>& indices = model_data.indices;
+        if (indices.empty()) return;
+        const bool reduce_overdraw = options.overdraw_threshold >= 1.0f;
+        VertexCacheStats before = analyze_vertex_cache(indices, model_data.vertices.size(), stats_cache_size);
+        OverdrawStats overdraw_before{};
+        if (reduce_overdraw) overdraw_before = analyze_overdraw(model_data.vertices, indices);
+        for (const auto& mesh: model_data.meshes)
+        {
+            if (mesh.index_count < 3) continue;
+            std::span<uint32_t> mesh_indices(indices.data() + mesh.index_offset, mesh.index_count);
+            // every primitive references its own contiguous range of vertices
+            auto [min_idx, max_idx] = std::minmax_element(mesh_indices.begin(), mesh_indices.end());
+            optimize_vertex_cache(mesh_indices, *min_idx, *max_idx - *min_idx + 1);
+            if (reduce_overdraw) optimize_overdraw(mesh_indices, model_data.vertices, options.overdraw_threshold);
+        }
+        const std::size_t vertex_count = model_data.vertices.size();
+        optimize_vertex_fetch(model_data.vertices, indices);
+        VertexCacheStats after = analyze_vertex_cache(indices, model_data.vertices.size(), stats_cache_size);
+        VE_LOG_CONSOLE(VE_INFO, "Vertex cache optimization of \"" << model_data.name << "\": ACMR " << ve::to_string(before.acmr, 3) << " -> " << ve::to_string(after.acmr, 3) << ", ATVR " << ve::to_string(before.atvr, 3) << " -> " << ve::to_string(after.atvr, 3) << "\n");
+        if (vertex_count != model_data.vertices.size()) VE_LOG_CONSOLE(VE_INFO, "Removed " << vertex_count - model_data.vertices.size() << " unreferenced vertices from \"" << model_data.name << "\"\n");
+        if (reduce_overdraw)
+        {
+            OverdrawStats overdraw_after = analyze_overdraw(model_data.vertices, indices);
+            VE_LOG_CONSOLE(VE_INFO, "Overdraw optimization of \"" << model_data.name << "\": overdraw " << ve::to_string(overdraw_before.overdraw, 3) << " -> " << ve::to_string(overdraw_after.overdraw, 3) << "\n");
+        }
+    }
+
+    void MeshOptimizer::optimize_vertex_cache(std::span<uint32_t> indices, uint32_t base_vertex, uint32_t vertex_count)
+    {
+        const uint32_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) return;
+
+        // triangle adjacency of every vertex, the list of a vertex only contains the triangles that are not yet emitted
+        std::vector<uint32_t> remaining_triangles(vertex_count, 0);
+        for (uint32_t i = 0; i < triangle_count * 3; ++i) ++remaining_triangles[indices[i] - base_vertex];
+        std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+        for (uint32_t i = 0; i < vertex_count; ++i) adjacency_offsets[i + 1] = adjacency_offsets[i] + remaining_triangles[i];
+        std::vector<uint32_t> adjacency(triangle_count * 3);
+        {
+            std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+            for (uint32_t i = 0; i < triangle_count * 3; ++i) adjacency[fill[indices[i] - base_vertex]++] = i / 3;
+        }
+
+        std::vector<int32_t> cache_positions(vertex_count, -1);
+        std::vector<float> vertex_scores(vertex_count);
+        for (uint32_t i = 0; i < vertex_count; ++i) vertex_scores[i] = get_vertex_score(-1, remaining_triangles[i], optimizer_cache_size);
+        std::vector<float> triangle_scores(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (uint32_t t = 0; t < triangle_count; ++t)
+        {
+            triangle_scores[t] = vertex_scores[indices[t * 3] - base_vertex] + vertex_scores[indices[t * 3 + 1] - base_vertex] + vertex_scores[indices[t * 3 + 2] - base_vertex];
+        }
+
+        // the cache has room for the vertices of one additional triangle before it is truncated
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> new_cache;
+        cache.reserve(optimizer_cache_size + 3);
+        new_cache.reserve(optimizer_cache_size + 3);
+        std::vector<uint32_t> new_indices;
+        new_indices.reserve(triangle_count * 3);
+
+        uint32_t best_triangle = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+        uint32_t scan_position = 0;
+        for (uint32_t emitted_count = 0; emitted_count < triangle_count; ++emitted_count)
+        {
+            if (best_triangle == std::numeric_limits<uint32_t>::max())
+            {
+                // no triangle in the cache is left, continue with the next triangle that was not emitted yet
+                while (emitted[scan_position]) ++scan_position;
+                best_triangle = scan_position;
+            }
+            emitted[best_triangle] = true;
+            new_cache.clear();
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                const uint32_t v = indices[best_triangle * 3 + i] - base_vertex;
+                new_indices.push_back(v + base_vertex);
+                if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) new_cache.push_back(v);
+                // remove the emitted triangle from the adjacency of the vertex
+                uint32_t* begin = adjacency.data() + adjacency_offsets[v];
+                uint32_t* end = begin + remaining_triangles[v];
+                std::swap(*std::find(begin, end, best_triangle), *(end - 1));
+                --remaining_triangles[v];
+            }
+            for (uint32_t v: cache)
+            {
+                if (std::find(new_cache.begin(), new_cache.end(), v) == new_cache.end()) new_cache.push_back(v);
+            }
+            // vertices that fall out of the cache lose their cache bonus
+            for (uint32_t i = optimizer_cache_size; i < new_cache.size(); ++i)
+            {
+                cache_positions[new_cache[i]] = -1;
+                vertex_scores[new_cache[i]] = get_vertex_score(-1, remaining_triangles[new_cache[i]], optimizer_cache_size);
+            }
+            if (new_cache.size() > optimizer_cache_size) new_cache.resize(optimizer_cache_size);
+            std::swap(cache, new_cache);
+
+            for (uint32_t i = 0; i < cache.size(); ++i)
+            {
+                cache_positions[cache[i]] = i;
+                vertex_scores[cache[i]] = get_vertex_score(i, remaining_triangles[cache[i]], optimizer_cache_size);
+            }
+            // only triangles of cached vertices changed their score, so the next triangle is chosen from those
+            best_triangle = std::numeric_limits<uint32_t>::max();
+            float best_score = -1.0f;
+            for (uint32_t v: cache)
+            {
+                for (uint32_t j = adjacency_offsets[v]; j < adjacency_offsets[v] + remaining_triangles[v]; ++j)
+                {
+                    const uint32_t t = adjacency[j];
+                    triangle_scores[t] = vertex_scores[indices[t * 3] - base_vertex] + vertex_scores[indices[t * 3 + 1] - base_vertex] + vertex_scores[indices[t * 3 + 2] - base_vertex];
+                    if (triangle_scores[t] > best_score)
+                    {
+                        best_score = triangle_scores[t];
+                        best_triangle = t;
+                    }
+                }
+            }
+        }
+        std::copy(new_indices.begin(), new_indices.end(), indices.begin());
+    }
+
+    void MeshOptimizer::optimize_overdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold)
+    {
+        // "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander et al.)
+        // the vertex cache optimized order is split into clusters that are sorted so that clusters facing away from the mesh center are drawn first
+        const uint32_t triangle_count = indices.size() / 3;
+        if (triangle_count < 2) return;
+        uint32_t base_vertex = *std::min_element(indices.begin(), indices.end());
+        uint32_t vertex_count = *std::max_element(indices.begin(), indices.end()) - base_vertex + 1;
+        std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+        uint32_t timestamp = stats_cache_size + 1;
+        std::vector<uint32_t> local_indices(indices.size());
+        for (uint32_t i = 0; i < indices.size(); ++i) local_indices[i] = indices[i] - base_vertex;
+
+        // hard boundaries are triangles that miss the cache with all vertices, they usually start a disjoint patch of the mesh
+        std::vector<uint32_t> hard_boundaries;
+        for (uint32_t t = 0; t < triangle_count; ++t)
+        {
+            if (update_cache(&local_indices[t * 3], stats_cache_size, cache_timestamps, timestamp) == 3 || t == 0) hard_boundaries.push_back(t);
+        }
+
+        // soft boundaries split the hard clusters further as long as the ACMR of the resulting clusters stays within the threshold
+        std::vector<uint32_t> boundaries;
+        for (uint32_t c = 0; c < hard_boundaries.size(); ++c)
+        {
+            const uint32_t start = hard_boundaries[c];
+            const uint32_t end = c + 1 < hard_boundaries.size() ? hard_boundaries[c + 1] : triangle_count;
+            // flush the cache by advancing the timestamp
+            timestamp += stats_cache_size + 1;
+            uint32_t cluster_misses = 0;
+            for (uint32_t t = start; t < end; ++t) cluster_misses += update_cache(&local_indices[t * 3], stats_cache_size, cache_timestamps, timestamp);
+            const float cluster_threshold = threshold * float(cluster_misses) / float(end - start);
+
+            const std::size_t first_boundary = boundaries.size();
+            boundaries.push_back(start);
+            timestamp += stats_cache_size + 1;
+            uint32_t running_misses = 0;
+            uint32_t running_triangles = 0;
+            for (uint32_t t = start; t < end; ++t)
+            {
+                running_misses += update_cache(&local_indices[t * 3], stats_cache_size, cache_timestamps, timestamp);
+                ++running_triangles;
+                if (float(running_misses) / float(running_triangles) <= cluster_threshold && t + 1 < end)
+                {
+                    boundaries.push_back(t + 1);
+                    timestamp += stats_cache_size + 1;
+                    running_misses = 0;
+                    running_triangles = 0;
+                }
+            }
+            // the remaining triangles did not reach the target ACMR on their own, so they are merged into the previous cluster
+            if (running_triangles > 0 && boundaries.size() - first_boundary > 1) boundaries.pop_back();
+        }
+
+        // sort key of a cluster is the distance of its plane from the mesh centroid along the averaged cluster normal
+        auto get_position = [&](uint32_t local_idx) -> std::array<float, 3> {
+            const auto& pos = vertices[local_idx + base_vertex].pos;
+            return {pos.x, pos.y, pos.z};
+        };
+        std::vector<std::array<float, 3>> centroids(boundaries.size(), {0.0f, 0.0f, 0.0f});
+        std::vector<std::array<float, 3>> normals(boundaries.size(), {0.0f, 0.0f, 0.0f});
+        std::vector<float> areas(boundaries.size(), 0.0f);
+        std::array<float, 3> mesh_centroid{0.0f, 0.0f, 0.0f};
+        float mesh_area = 0.0f;
+        for (uint32_t c = 0; c < boundaries.size(); ++c)
+        {
+            const uint32_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangle_count;
+            for (uint32_t t = boundaries[c]; t < end; ++t)
+            {
+                const std::array<float, 3> p0 = get_position(local_indices[t * 3]);
+                const std::array<float, 3> p1 = get_position(local_indices[t * 3 + 1]);
+                const std::array<float, 3> p2 = get_position(local_indices[t * 3 + 2]);
+                const std::array<float, 3> e0{p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                const std::array<float, 3> e1{p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                const std::array<float, 3> n{e0[1] * e1[2] - e0[2] * e1[1], e0[2] * e1[0] - e0[0] * e1[2], e0[0] * e1[1] - e0[1] * e1[0]};
+                const float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    const float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                    centroids[c][k] += center * area;
+                    mesh_centroid[k] += center * area;
+                    normals[c][k] += n[k];
+                }
+                areas[c] += area;
+            }
+            mesh_area += areas[c];
+        }
+        for (uint32_t k = 0; k < 3; ++k) mesh_centroid[k] /= std::max(mesh_area, std::numeric_limits<float>::min());
+        std::vector<float> sort_keys(boundaries.size());
+        for (uint32_t c = 0; c < boundaries.size(); ++c)
+        {
+            const float normal_length = std::sqrt(normals[c][0] * normals[c][0] + normals[c][1] * normals[c][1] + normals[c][2] * normals[c][2]);
+            float key = 0.0f;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const float centroid = centroids[c][k] / std::max(areas[c], std::numeric_limits<float>::min());
+                key += (centroid - mesh_centroid[k]) * normals[c][k] / std::max(normal_length, std::numeric_limits<float>::min());
+            }
+            sort_keys[c] = key;
+        }
+        std::vector<uint32_t> cluster_order(boundaries.size());
+        for (uint32_t c = 0; c < cluster_order.size(); ++c) cluster_order[c] = c;
+        std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b) -> bool { return sort_keys[a] > sort_keys[b]; });
+
+        uint32_t idx = 0;
+        for (uint32_t c: cluster_order)
+        {
+            const uint32_t end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangle_count;
+            for (uint32_t i = boundaries[c] * 3; i < end * 3; ++i) indices[idx++] = local_indices[i] + base_vertex;
+        }
+    }
+
+    void MeshOptimizer::optimize_vertex_fetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        // order the vertices by their first use so that consecutive triangles fetch neighboring memory
+        constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertices.size(), unused);
+        std::vector<Vertex> new_vertices;
+        new_vertices.reserve(vertices.size());
+        for (uint32_t& index: indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = new_vertices.size();
+                new_vertices.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices = std::move(new_vertices);
+    }
+
+    MeshOptimizer::VertexCacheStats MeshOptimizer::analyze_vertex_cache(std::span<const uint32_t> indices, uint32_t vertex_count, uint32_t cache_size)
+    {
+        // simulate a FIFO cache like the one of most GPUs
+        std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+        std::vector<bool> used(vertex_count, false);
+        uint32_t timestamp = cache_size + 1;
+        uint32_t unique_vertices = 0;
+        for (uint32_t index: indices)
+        {
+            if (timestamp - cache_timestamps[index] > cache_size)
+            {
+                cache_timestamps[index] = timestamp++;
+            }
+            if (!used[index])
+            {
+                used[index] = true;
+                ++unique_vertices;
+            }
+        }
+        const uint32_t misses = timestamp - cache_size - 1;
+        VertexCacheStats stats{};
+        stats.acmr = indices.size() >= 3 ? float(misses) / float(indices.size() / 3) : 0.0f;
+        stats.atvr = unique_vertices > 0 ? float(misses) / float(unique_vertices) : 0.0f;
+        return stats;
+    }
+
+    MeshOptimizer::OverdrawStats MeshOptimizer::analyze_overdraw(std::span<const Vertex> vertices, std::span<const uint32_t> indices)
+    {
+        OverdrawStats stats{};
+        if (indices.size() < 3) return stats;
+        // normalize the mesh into the unit cube while keeping its proportions
+        std::array<float, 3> min_pos{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        std::array<float, 3> max_pos{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+        for (uint32_t index: indices)
+        {
+            const auto& pos = vertices[index].pos;
+            const std::array<float, 3> p{pos.x, pos.y, pos.z};
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                min_pos[k] = std::min(min_pos[k], p[k]);
+                max_pos[k] = std::max(max_pos[k], p[k]);
+            }
+        }
+        const float extent = std::max(std::max(max_pos[0] - min_pos[0], max_pos[1] - min_pos[1]), std::max(max_pos[2] - min_pos[2], std::numeric_limits<float>::min()));
+
+        std::vector<float> depth(overdraw_grid_size * overdraw_grid_size);
+        std::vector<bool> covered(overdraw_grid_size * overdraw_grid_size);
+        // rasterize the mesh in draw order with back face culling and a depth test from both sides of every axis, like a camera orbiting the mesh would see it
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            for (float direction: {1.0f, -1.0f})
+            {
+                std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+                std::fill(covered.begin(), covered.end(), false);
+                auto project = [&](uint32_t index) -> std::array<float, 3> {
+                    const auto& pos = vertices[index].pos;
+                    const std::array<float, 3> p{(pos.x - min_pos[0]) / extent, (pos.y - min_pos[1]) / extent, (pos.z - min_pos[2]) / extent};
+                    // screen x and y are the two remaining axes, depth is measured along the view direction
+                    return {p[(axis + 1) % 3] * overdraw_grid_size, p[(axis + 2) % 3] * overdraw_grid_size, direction > 0.0f ? p[axis] : 1.0f - p[axis]};
+                };
+                for (uint32_t t = 0; t + 2 < indices.size(); t += 3)
+                {
+                    const std::array<float, 3> v0 = project(indices[t]);
+                    const std::array<float, 3> v1 = project(indices[t + 1]);
+                    const std::array<float, 3> v2 = project(indices[t + 2]);
+                    const float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+                    // the screen axes are chosen cyclically, so the signed area is the component of the triangle normal along the view axis
+                    // the camera looks along the positive axis for a positive direction, triangles facing away from it are culled
+                    if (area * direction >= 0.0f) continue;
+                    const int32_t min_x = std::max(0, int32_t(std::floor(std::min({v0[0], v1[0], v2[0]}))));
+                    const int32_t max_x = std::min(int32_t(overdraw_grid_size) - 1, int32_t(std::ceil(std::max({v0[0], v1[0], v2[0]}))));
+                    const int32_t min_y = std::max(0, int32_t(std::floor(std::min({v0[1], v1[1], v2[1]}))));
+                    const int32_t max_y = std::min(int32_t(overdraw_grid_size) - 1, int32_t(std::ceil(std::max({v0[1], v1[1], v2[1]}))));
+                    for (int32_t y = min_y; y <= max_y; ++y)
+                    {
+                        for (int32_t x = min_x; x <= max_x; ++x)
+                        {
+                            // barycentric coordinates of the pixel center
+                            const float px = x + 0.5f;
+                            const float py = y + 0.5f;
+                            const float w0 = ((v1[0] - px) * (v2[1] - py) - (v1[1] - py) * (v2[0] - px)) / area;
+                            const float w1 = ((v2[0] - px) * (v0[1] - py) - (v2[1] - py) * (v0[0] - px)) / area;
+                            const float w2 = 1.0f - w0 - w1;
+                            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+                            const float z = w0 * v0[2] + w1 * v1[2] + w2 * v2[2];
+                            const uint32_t pixel = y * overdraw_grid_size + x;
+                            if (z < depth[pixel])
+                            {
+                                depth[pixel] = z;
+                                ++stats.pixels_shaded;
+                            }
+                            if (!covered[pixel])
+                            {
+                                covered[pixel] = true;
+                                ++stats.pixels_covered;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        stats.overdraw = stats.pixels_covered > 0 ? float(stats.pixels_shaded) / float(stats.pixels_covered) : 0.0f;
+        return stats;
+    }
+
+    uint32_t MeshOptimizer::update_cache(const uint32_t* triangle, uint32_t cache_size, std::vector<uint32_t>& cache_timestamps, uint32_t& timestamp)
+    {
+        // FIFO cache simulation, returns the number of vertices of the triangle that missed the cache
+        uint32_t misses = 0;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            if (timestamp - cache_timestamps[triangle[i]] > cache_size)
+            {
+                cache_timestamps[triangle[i]] = timestamp++;
+                ++misses;
+            }
+        }
+        return misses;
+    }
+}// namespace ve
@@ -1,44 +1,167 @@
 #include "vk/Model.hpp"
 
 #include <string>
+#include <thread>
 
 #define TINYGLTF_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "tiny_gltf.h"
+#include <glm/gtc/packing.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/transform.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
 
+#include "ThreadPool.hpp"
 #include "vk/DescriptorSetHandler.hpp"
+#include "vk/MeshCache.hpp"
+#include "vk/MeshOptimizer.hpp"
+#include "vk/TextureCompressor.hpp"
+#include "vk/VertexConversion.hpp"
 #include "vk/common.hpp"
 
 namespace ve
 {
-    Model::Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, const std::string& path) : vmc(vmc), vcc(vcc), name(path.substr(path.find_last_of('/'), path.length())), transformation(glm::mat4(1.0f))
+    namespace
     {
-        VE_LOG_CONSOLE(VE_INFO, "Loading glb: \"" << path << "\"\n");
-        load_model(path);
+        // shared by all models that are loaded concurrently, so that the number of decoding threads stays bounded
+        ThreadPool& get_image_decoding_pool()
+        {
+            static ThreadPool pool(std::thread::hardware_concurrency());
+            return pool;
+        }
+
+        // replaces the decoding of tinygltf, only the size of the image is read and the encoded file is kept for ModelData::decode_image
+        bool store_encoded_image(tinygltf::Image* image, const int image_idx, std::string* err, std::string* warn, int req_width, int req_height, const unsigned char* bytes, int size, void* user_data)
+        {
+            int width, height, components;
+            if (!stbi_info_from_memory(bytes, size, &width, &height, &components))
+            {
+                if (err) (*err) += "Unknown image format of image[" + std::to_string(image_idx) + "] name = \"" + image->name + "\"\n";
+                return false;
+            }
+            // images are always decoded to 8 bit RGBA
+            image->width = width;
+            image->height = height;
+            image->component = 4;
+            image->bits = 8;
+            image->pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+            ModelData* model_data = static_cast<ModelData*>(user_data);
+            if (model_data->encoded_images.size() <= size_t(image_idx)) model_data->encoded_images.resize(image_idx + 1);
+            model_data->encoded_images[image_idx] = std::span<const unsigned char>(bytes, size);
+            return true;
+        }
+
+        // tinygltf fills the typed fields with the defaults of the glTF specification for missing values
+        ModelData::MaterialFactors get_material_factors(const tinygltf::Material& mat)
+        {
+            ModelData::MaterialFactors factors;
+            if (mat.pbrMetallicRoughness.baseColorFactor.size() == 4) factors.base_color = glm::make_vec4(mat.pbrMetallicRoughness.baseColorFactor.data());
+            if (mat.emissiveFactor.size() == 3) factors.emission = glm::vec4(glm::make_vec3(mat.emissiveFactor.data()), 1.0);
+            factors.metallic = static_cast<float>(mat.pbrMetallicRoughness.metallicFactor);
+            factors.roughness = static_cast<float>(mat.pbrMetallicRoughness.roughnessFactor);
+            return factors;
+        }
+    }// namespace
+
+    uint32_t TextureImportOptions::get_base_mip_level(TextureRole role, uint32_t width, uint32_t height) const
+    {
+        const TextureBudget& budget = budgets[uint32_t(role)];
+        const uint32_t size = std::max({width, height, 1u});
+        const uint32_t last_level = std::bit_width(size) - 1;
+        uint32_t level = std::min(budget.mip_bias, last_level);
+        while ((size >> level) > std::max(1u, budget.max_resolution)) ++level;
+        return level;
     }
 
-    Model::Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material) : vmc(vmc), vcc(vcc), name("custom model"), transformation(glm::mat4(1.0f))
+    void ModelData::decode_image(int image_idx, uint32_t base_mip_level, bool srgb)
     {
-        vertex_buffer = Buffer(vmc, vertices, vk::BufferUsageFlagBits::eVertexBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, vcc);
-        index_buffer = Buffer(vmc, indices, vk::BufferUsageFlagBits::eIndexBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, vcc);
-        meshes.emplace_back(Mesh(vmc, vcc, material, 0, indices.size()));
+        if (decoded_images.size() < gltf_model.images.size()) decoded_images.resize(gltf_model.images.size());
+        if (decoded_images[image_idx].valid() || size_t(image_idx) >= encoded_images.size() || encoded_images[image_idx].empty()) return;
+        // the task shares the mapping of the glb file, as it may outlive this ModelData
+        decoded_images[image_idx] = get_image_decoding_pool().submit([glb_file = glb_file, encoded = std::exchange(encoded_images[image_idx], {}), image_idx, base_mip_level, srgb]() {
+            int width, height, components;
+            stbi_uc* pixels = stbi_load_from_memory(encoded.data(), encoded.size(), &width, &height, &components, STBI_rgb_alpha);
+            if (!pixels) VE_THROW("Failed to decode image " << image_idx << ": " << stbi_failure_reason() << "\n");
+            DecodedImage result{std::vector<unsigned char>(pixels, pixels + std::size_t(width) * height * 4), uint32_t(width), uint32_t(height)};
+            stbi_image_free(pixels);
+            // the levels above the budget are never uploaded, so they are dropped on the worker thread
+            for (uint32_t i = 0; i < base_mip_level && (result.width > 1 || result.height > 1); ++i)
+            {
+                result.pixels = TextureCompressor::downsample(result.pixels, result.width, result.height, srgb);
+                result.width = std::max(1u, result.width / 2);
+                result.height = std::max(1u, result.height / 2);
+            }
+            return result;
+        });
     }
 
-    void Model::add_set_bindings(DescriptorSetHandler& dsh)
+    const tinygltf::Image& ModelData::wait_for_image(int image_idx)
+    {
+        decode_image(image_idx);
+        tinygltf::Image& image = gltf_model.images[image_idx];
+        if (decoded_images[image_idx].valid())
+        {
+            DecodedImage decoded = decoded_images[image_idx].get();
+            image.image = std::move(decoded.pixels);
+            image.width = decoded.width;
+            image.height = decoded.height;
+        }
+        return image;
+    }
+
+    Model::Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, const std::string& path) : Model(vmc, vcc, upload, geometry_heap, load_model_data(path, ImportOptions()))
+    {}
+
+    Model::Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, ModelData&& model_data) : vmc(vmc), vcc(vcc), geometry_heap(&geometry_heap), name(model_data.name), transformation(glm::mat4(1.0f)), dequantization(glm::mat4(1.0f))
+    {
+        upload_model_data(model_data, upload);
+    }
+
+    Model::Model(const VulkanMainContext& vmc, VulkanCommandContext& vcc, UploadContext& upload, GeometryHeap& geometry_heap, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material, VertexFormat vertex_format) : vmc(vmc), vcc(vcc), geometry_heap(&geometry_heap), name("custom model"), transformation(glm::mat4(1.0f)), dequantization(glm::mat4(1.0f))
+    {
+        ModelData model_data;
+        model_data.vertices = vertices;
+        model_data.indices = indices;
+        model_data.meshes.push_back({-1, 0, uint32_t(indices.size())});
+        if (vertex_format == VertexFormat::Quantized) quantize_vertices(model_data);
+        pack_indices(model_data);
+        upload_geometry(model_data, upload);
+        add_mesh(model_data.meshes.front(), material);
+    }
+
+    void Model::add_material_sets(DescriptorSetHandler& material_dsh, std::unordered_map<const Material*, uint32_t>& material_sets, const Image& fallback_texture)
     {
         for (auto& mesh: meshes)
         {
-            mesh.add_set_bindings(dsh);
+            mesh.add_material_set(material_dsh, material_sets, fallback_texture);
+        }
+    }
+
+    void Model::add_materials(BindlessTable& bindless_table)
+    {
+        for (auto& mesh: meshes)
+        {
+            mesh.add_material(bindless_table);
+        }
+    }
+
+    void Model::relocate(Defragmenter::Relocations& relocations)
+    {
+        for (auto& texture: textures)
+        {
+            if (texture.has_value()) texture.value().relocate(relocations);
         }
     }
 
     void Model::self_destruct()
     {
-        vertex_buffer.self_destruct();
-        index_buffer.self_destruct();
+        geometry_heap->free(geometry);
         for (auto& mesh: meshes)
         {
             mesh.self_destruct();
@@ -51,15 +174,16 @@ namespace ve
         textures.clear();
     }
 
-    void Model::draw(uint32_t current_frame, const vk::PipelineLayout& layout, const std::vector<vk::DescriptorSet>& sets, const glm::mat4& vp)
+    void Model::draw(uint32_t current_frame, const vk::PipelineLayout& layout, DescriptorSetHandler& material_dsh, const glm::mat4& vp)
     {
-        PushConstants pc{vp * transformation};
-        vcc.graphics_cb[current_frame].pushConstants(layout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(PushConstants), &pc);
-        vcc.graphics_cb[current_frame].bindVertexBuffers(0, vertex_buffer.get(), {0});
-        vcc.graphics_cb[current_frame].bindIndexBuffer(index_buffer.get(), 0, vk::IndexType::eUint32);
+        // the dequantization of quantized positions is folded into the MVP matrix
+        const glm::mat4 mvp = vp * transformation * dequantization;
+        vcc.graphics_cb[current_frame].pushConstants(layout, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, offsetof(PushConstants, MVP), sizeof(glm::mat4), &mvp);
         for (auto& mesh: meshes)
         {
-            mesh.draw(vcc.graphics_cb[current_frame], layout, sets, current_frame);
+            // the buffers of the heap are only rebound if the block or the index type of the mesh changes
+            geometry_heap->bind(vcc.graphics_cb[current_frame], geometry.block, mesh.get_index_type());
+            mesh.draw(vcc.graphics_cb[current_frame], layout, material_dsh);
         }
     }
 
@@ -81,18 +205,69 @@ namespace ve
         translate(translation);
     }
 
-    void Model::load_model(const std::string& path)
+    ModelData Model::load_model_data(const std::string& path, const ImportOptions& options, const TextureImportOptions& texture_options)
     {
-        tinygltf::TinyGLTF loader;
-        tinygltf::Model model;
+        VE_LOG_CONSOLE(VE_INFO, "Loading glb: \"" << path << "\"\n");
+        ModelData model_data;
+        model_data.name = path.substr(path.find_last_of('/'), path.length());
+        std::shared_ptr<GlbFile> glb_file = std::make_shared<GlbFile>(path);
+        if (!glb_file->is_valid()) VE_THROW("Failed to load glb: \"" << path << "\"\n");
+        // geometry that was processed with other options is not valid for this import
+        const uint64_t content_hash = MeshCache::hash(glb_file->data(), glb_file->size());
+        const uint64_t options_hash = MeshCache::hash(reinterpret_cast<const unsigned char*>(&options), sizeof(ImportOptions));
+        const bool cache_hit = MeshCache::load(path, content_hash, options_hash, model_data);
+        if (!model_data.requires_gltf) return model_data;
+
         std::string err;
         std::string warn;
-        if (!loader.LoadBinaryFromFile(&model, &err, &warn, path)) VE_THROW("Failed to load glb: \"" << path << "\"\n");
+        if (!glb_file->load(model_data.gltf_model, &err, &warn, &store_encoded_image, &model_data)) VE_THROW("Failed to load glb: \"" << path << "\"\n" << err);
+        model_data.glb_file = glb_file;
         if (!warn.empty()) VE_LOG_CONSOLE(VE_WARN, VE_C_YELLOW << warn << "\n");
         if (!err.empty()) VE_THROW(err);
+        model_data.texture_options = texture_options;
+        model_data.texture_roles = TextureCompressor::get_texture_roles(model_data.gltf_model);
+        if (texture_options.compress) TextureCompressor::compress_textures(model_data);
+        // the remaining images are decoded in the background while the geometry is processed and the model is uploaded
+        // images that are shared by textures of several roles keep the largest base level of them
+        std::vector<std::optional<uint32_t>> image_base_mip_levels(model_data.gltf_model.images.size());
+        std::vector<bool> image_srgb(model_data.gltf_model.images.size(), false);
+        for (uint32_t i = 0; i < model_data.gltf_model.textures.size(); ++i)
+        {
+            const int source = model_data.gltf_model.textures[i].source;
+            const bool compressed = i < model_data.compressed_textures.size() && model_data.compressed_textures[i].has_value();
+            if (source < 0 || compressed || !model_data.texture_roles[i].has_value()) continue;
+            const TextureRole role = model_data.texture_roles[i].value();
+            const tinygltf::Image& image = model_data.gltf_model.images[source];
+            const uint32_t base_mip_level = texture_options.get_base_mip_level(role, image.width, image.height);
+            image_base_mip_levels[source] = std::min(image_base_mip_levels[source].value_or(base_mip_level), base_mip_level);
+            image_srgb[source] = image_srgb[source] || TextureCompressor::is_srgb(role);
+        }
+        for (uint32_t i = 0; i < image_base_mip_levels.size(); ++i)
+        {
+            if (image_base_mip_levels[i].has_value()) model_data.decode_image(i, image_base_mip_levels[i].value(), image_srgb[i]);
+        }
+        if (cache_hit) return model_data;
+
+        const tinygltf::Model& model = model_data.gltf_model;
+        for (const auto& mat: model.materials) model_data.material_factors.push_back(get_material_factors(mat));
+        const tinygltf::Scene& scene = model.scenes[model.defaultScene > -1 ? model.defaultScene : 0];
+        // traverse scene nodes
+        for (auto& node_idx: scene.nodes)
+        {
+            process_node(model.nodes[node_idx], model, glm::mat4(1.0f), model_data);
+        }
+        MeshOptimizer::optimize(model_data, options);
+        // quantization needs the bounds of the whole model and therefore runs after all meshes are processed
+        if (options.vertex_format == VertexFormat::Quantized) quantize_vertices(model_data);
+        pack_indices(model_data);
+        MeshCache::store(path, content_hash, options_hash, model_data);
+        return model_data;
+    }
 
-        textures.resize(model.textures.size());
-        materials.resize(model.materials.size() + 1);
+    void Model::upload_model_data(ModelData& model_data, UploadContext& upload)
+    {
+        textures.resize(model_data.gltf_model.textures.size());
+        materials.resize(model_data.material_factors.size() + 1);
         Material default_mat;
         default_mat.base_texture = nullptr;
         default_mat.metallic_roughness_texture = nullptr;
@@ -101,62 +276,168 @@ namespace ve
         default_mat.occlusion_texture = nullptr;
         materials.back().emplace(default_mat);
 
-        const tinygltf::Scene& scene = model.scenes[model.defaultScene > -1 ? model.defaultScene : 0];
-        // traverse scene nodes
-        for (auto& node_idx: scene.nodes)
+        upload_geometry(model_data, upload);
+        for (const auto& mesh_data: model_data.meshes)
         {
-            process_node(model.nodes[node_idx], model, glm::mat4(1.0f));
+            add_mesh(mesh_data, load_material(mesh_data.material_idx, model_data, upload));
         }
-        vertex_buffer = Buffer(vmc, vertices, vk::BufferUsageFlagBits::eVertexBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, vcc);
-        index_buffer = Buffer(vmc, indices, vk::BufferUsageFlagBits::eIndexBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, vcc);
-        // delete vertices and indices on host
-        indices.clear();
-        vertices.clear();
     }
 
-    Material* Model::load_material(int mat_idx, const tinygltf::Model& model)
+    void Model::upload_geometry(const ModelData& model_data, UploadContext& upload)
     {
-        if (mat_idx < 0) return &materials.back().value();
-        const tinygltf::Material& mat = model.materials[mat_idx];
+        std::span<const unsigned char> vertex_data = model_data.get_vertex_data();
+        std::span<const unsigned char> index_data = model_data.get_index_data();
+        const vk::DeviceSize vertex_stride = model_data.vertex_format == VertexFormat::Quantized ? sizeof(QuantizedVertex) : sizeof(Vertex);
+        geometry = geometry_heap->allocate(vertex_data.size(), vertex_stride, index_data.size());
+        geometry_heap->upload(upload, geometry, vertex_data, index_data);
+        if (model_data.vertex_format == VertexFormat::Quantized)
+        {
+            dequantization = glm::translate(model_data.position_offset) * glm::scale(model_data.position_scale);
+        }
+    }
 
-        auto get_texture = [&](const std::string& name, uint32_t base_mip_level) -> Image* {
-            if (mat.values.find(name) == mat.values.end()) return nullptr;
-            int texture_idx = mat.values.at(name).TextureIndex();
-            if (textures[texture_idx].has_value()) return &textures[texture_idx].value();
-            const tinygltf::Texture& tex = model.textures[texture_idx];
-            Image base_image(vmc, vcc, {uint32_t(vmc.queues_family_indices.transfer)}, model.images[tex.source].image.data(), model.images[tex.source].width, model.images[tex.source].height, true);
-            textures[texture_idx].emplace(Image(vmc, vcc, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, base_image, base_mip_level));
-            base_image.self_destruct();
-            return &textures[texture_idx].value();
-        };
+    void Model::add_mesh(const ModelData::MeshData& mesh_data, const Material* material)
+    {
+        meshes.emplace_back(Mesh(vmc, vcc, material, geometry.get_first_index(mesh_data.index_type) + mesh_data.index_offset, mesh_data.index_count, geometry.first_vertex + mesh_data.vertex_offset, mesh_data.index_type));
+    }
 
-        Material material{};
-        material.base_texture = get_texture("baseColorTexture", 1);
-        material.metallic_roughness_texture = get_texture("metallicRoughnessTexture", 1);
-        material.normal_texture = get_texture("normalTexture", 1);
-        material.emissive_texture = get_texture("emissiveTexture", 1);
-        material.occlusion_texture = get_texture("occlusionTexture", 1);
-        if (mat.values.find("baseColorFactor") != mat.values.end())
+    void Model::pack_indices(ModelData& model_data)
+    {
+        model_data.index_data.clear();
+        for (auto& mesh: model_data.meshes)
+        {
+            std::span<const uint32_t> mesh_indices(model_data.indices.data() + mesh.index_offset, mesh.index_count);
+            uint32_t min_idx = 0;
+            uint32_t max_idx = 0;
+            if (!mesh_indices.empty())
+            {
+                auto [min_it, max_it] = std::minmax_element(mesh_indices.begin(), mesh_indices.end());
+                min_idx = *min_it;
+                max_idx = *max_it;
+            }
+            // the local vertex range of most primitives fits into 16 bit indices, which halves the index memory
+            const bool use_16_bit = max_idx - min_idx <= std::numeric_limits<uint16_t>::max();
+            const std::size_t index_size = use_16_bit ? sizeof(uint16_t) : sizeof(uint32_t);
+            // index buffer offsets have to be a multiple of the index size
+            std::size_t byte_offset = (model_data.index_data.size() + index_size - 1) / index_size * index_size;
+            model_data.index_data.resize(byte_offset + mesh_indices.size() * index_size);
+            for (std::size_t i = 0; i < mesh_indices.size(); ++i)
+            {
+                const uint32_t local_idx = mesh_indices[i] - min_idx;
+                if (use_16_bit)
+                {
+                    const uint16_t idx = uint16_t(local_idx);
+                    memcpy(model_data.index_data.data() + byte_offset + i * index_size, &idx, index_size);
+                }
+                else
+                {
+                    memcpy(model_data.index_data.data() + byte_offset + i * index_size, &local_idx, index_size);
+                }
+            }
+            mesh.index_offset = byte_offset / index_size;
+            mesh.vertex_offset = int32_t(min_idx);
+            mesh.index_type = use_16_bit ? vk::IndexType::eUint16 : vk::IndexType::eUint32;
+        }
+        model_data.indices.clear();
+        model_data.indices.shrink_to_fit();
+    }
+
+    void Model::quantize_vertices(ModelData& model_data)
+    {
+        glm::vec3 min_pos(std::numeric_limits<float>::max());
+        glm::vec3 max_pos(std::numeric_limits<float>::lowest());
+        for (const auto& vertex: model_data.vertices)
         {
-            material.base_color = glm::make_vec4(mat.values.at("baseColorFactor").ColorFactor().data());
+            min_pos = glm::min(min_pos, vertex.pos);
+            max_pos = glm::max(max_pos, vertex.pos);
         }
-        if (mat.values.find("metallicFactor") != mat.values.end())
+        glm::vec3 extent = max_pos - min_pos;
+        for (uint32_t i = 0; i < 3; ++i)
         {
-            material.metallic = static_cast<float>(mat.values.at("metallicFactor").Factor());
+            // flat models would otherwise divide by zero
+            if (!(extent[i] > 0.0f)) extent[i] = 1.0f;
         }
-        if (mat.values.find("roughnessFactor") != mat.values.end())
+        if (model_data.vertices.empty()) min_pos = glm::vec3(0.0f);
+
+        // octahedral mapping of the unit sphere onto [-1, 1]^2
+        auto encode_octahedral = [](const glm::vec3& n) -> glm::vec2 {
+            float l1_norm = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+            if (!(l1_norm > 0.0f)) return glm::vec2(0.0f);
+            glm::vec2 p = glm::vec2(n.x, n.y) / l1_norm;
+            if (n.z < 0.0f) p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * glm::vec2(p.x >= 0.0f ? 1.0f : -1.0f, p.y >= 0.0f ? 1.0f : -1.0f);
+            return p;
+        };
+
+        model_data.quantized_vertices.clear();
+        model_data.quantized_vertices.reserve(model_data.vertices.size());
+        for (const auto& vertex: model_data.vertices)
         {
-            material.roughness = static_cast<float>(mat.values.at("roughnessFactor").Factor());
+            QuantizedVertex quantized_vertex;
+            glm::vec3 normalized_pos = glm::clamp((vertex.pos - min_pos) / extent, 0.0f, 1.0f);
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                quantized_vertex.pos[i] = uint16_t(std::round(normalized_pos[i] * 65535.0f));
+            }
+            quantized_vertex.pos[3] = 0;
+            quantized_vertex.normal = glm::packSnorm2x16(encode_octahedral(vertex.normal));
+            quantized_vertex.color = glm::packUnorm4x8(vertex.color);
+            quantized_vertex.tex = glm::packHalf2x16(vertex.tex);
+            model_data.quantized_vertices.push_back(quantized_vertex);
         }
-        if (mat.additionalValues.find("emissiveFactor") != mat.additionalValues.end())
+        model_data.vertices.clear();
+        model_data.vertices.shrink_to_fit();
+        model_data.position_offset = min_pos;
+        model_data.position_scale = extent;
+        model_data.vertex_format = VertexFormat::Quantized;
+    }
+
+    Material* Model::load_material(int mat_idx, ModelData& model_data, UploadContext& upload)
+    {
+        const tinygltf::Model& model = model_data.gltf_model;
+        if (mat_idx < 0) return &materials.back().value();
+        if (materials[mat_idx].has_value()) return &materials[mat_idx].value();
+
+        Material material{};
+        const ModelData::MaterialFactors& factors = model_data.material_factors[mat_idx];
+        material.base_color = factors.base_color;
+        material.emission = factors.emission;
+        material.metallic = factors.metallic;
+        material.roughness = factors.roughness;
+        // models without textures can be loaded from the mesh cache without the glTF document
+        if (!model_data.requires_gltf)
         {
-            material.emission = glm::vec4(glm::make_vec3(mat.additionalValues.at("emissiveFactor").ColorFactor().data()), 1.0);
+            materials[mat_idx].emplace(material);
+            return &(materials[mat_idx].value());
         }
+        const tinygltf::Material& mat = model.materials[mat_idx];
+
+        auto get_texture = [&](int texture_idx, TextureRole role) -> Image* {
+            if (texture_idx < 0) return nullptr;
+            if (textures[texture_idx].has_value()) return &textures[texture_idx].value();
+            if (texture_idx < int(model_data.compressed_textures.size()) && model_data.compressed_textures[texture_idx].has_value())
+            {
+                const Ktx2Texture& texture = model_data.compressed_textures[texture_idx].value();
+                const uint32_t base_mip_level = model_data.texture_options.get_base_mip_level(role, texture.get_width(), texture.get_height());
+                textures[texture_idx].emplace(Image(vmc, upload, texture, base_mip_level));
+                return &textures[texture_idx].value();
+            }
+            const tinygltf::Texture& tex = model.textures[texture_idx];
+            // only waits for the images that are used by this material, they are already reduced to the texture budget
+            const tinygltf::Image& image = model_data.wait_for_image(tex.source);
+            textures[texture_idx].emplace(Image(vmc, upload, image.image.data(), image.width, image.height, true));
+            return &textures[texture_idx].value();
+        };
+
+        material.base_texture = get_texture(mat.pbrMetallicRoughness.baseColorTexture.index, TextureRole::BaseColor);
+        material.metallic_roughness_texture = get_texture(mat.pbrMetallicRoughness.metallicRoughnessTexture.index, TextureRole::MetallicRoughness);
+        material.normal_texture = get_texture(mat.normalTexture.index, TextureRole::Normal);
+        material.emissive_texture = get_texture(mat.emissiveTexture.index, TextureRole::Emissive);
+        material.occlusion_texture = get_texture(mat.occlusionTexture.index, TextureRole::Occlusion);
         materials[mat_idx].emplace(material);
         return &(materials[mat_idx].value());
     }
 
-    void Model::process_node(const tinygltf::Node& node, const tinygltf::Model& model, const glm::mat4 trans)
+    void Model::process_node(const tinygltf::Node& node, const tinygltf::Model& model, const glm::mat4 trans, ModelData& model_data)
     {
         glm::vec3 translation = (node.translation.size() == 3) ? glm::make_vec3(node.translation.data()) : glm::dvec3(0.0f);
         glm::quat q = (node.rotation.size() == 4) ? glm::make_quat(node.rotation.data()) : glm::qua<double>();
@@ -165,87 +446,89 @@ namespace ve
         matrix = trans * glm::translate(glm::mat4(1.0f), translation) * glm::mat4(q) * glm::scale(glm::mat4(1.0f), scale) * matrix;
         for (auto& child_idx: node.children)
         {
-            process_node(model.nodes[child_idx], model, matrix);
+            process_node(model.nodes[child_idx], model, matrix, model_data);
         }
-        if (node.mesh > -1) (process_mesh(model.meshes[node.mesh], model, matrix));
+        if (node.mesh > -1) (process_mesh(model.meshes[node.mesh], model, matrix, model_data));
     }
 
-    void Model::process_mesh(const tinygltf::Mesh& mesh, const tinygltf::Model& model, const glm::mat4 matrix)
+    void Model::process_mesh(const tinygltf::Mesh& mesh, const tinygltf::Model& model, const glm::mat4 matrix, ModelData& model_data)
     {
+        std::vector<Vertex>& vertices = model_data.vertices;
+        std::vector<uint32_t>& indices = model_data.indices;
+        const GlbFile& glb_file = *model_data.glb_file;
         for (const tinygltf::Primitive& primitive: mesh.primitives)
         {
             uint32_t idx_count = indices.size();
-            Material* mat = load_material(primitive.material, model);
+            uint32_t vertex_count = vertices.size();
+            // only the base color of the material is needed on the host, textures are loaded when uploading the model
+            glm::vec4 base_color(1.0f);
+            if (primitive.material > -1)
+            {
+                const tinygltf::Material& mat = model.materials[primitive.material];
+                if (mat.values.find("baseColorFactor") != mat.values.end())
+                {
+                    base_color = glm::make_vec4(mat.values.at("baseColorFactor").ColorFactor().data());
+                }
+            }
             // vertices
             {
-                const float* pos_buffer = nullptr;
-                const float* normal_buffer = nullptr;
-                const float* tex_buffer = nullptr;
-                const float* color_buffer = nullptr;
-
-                int pos_stride;
-                int normal_stride;
-                int tex_stride;
-                int color_stride;
+                // the attributes are read directly from the mapped glb file, stride and layout always come from the accessor
+                // normalized integer colors and texture coordinates are converted to floats first
+                std::vector<std::vector<float>> converted_streams;
+                auto get_stream = [&](const std::string& attribute) -> VertexConversion::AttributeStream {
+                    if (primitive.attributes.find(attribute) == primitive.attributes.end()) return {};
+                    const tinygltf::Accessor& accessor = model.accessors[primitive.attributes.find(attribute)->second];
+                    const GlbFile::AccessorView view = glb_file.get_accessor(model, primitive.attributes.find(attribute)->second);
+                    if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT) return {reinterpret_cast<const float*>(view.data), view.byte_stride / sizeof(float)};
+                    if (accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && accessor.componentType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) VE_THROW("Attribute " << attribute << " has an unsupported component type!");
+                    const uint32_t components = tinygltf::GetNumComponentsInType(accessor.type);
+                    std::vector<float>& converted = converted_streams.emplace_back(view.count * components);
+                    for (std::size_t i = 0; i < view.count; ++i)
+                    {
+                        const unsigned char* element = view.data + i * view.byte_stride;
+                        for (uint32_t c = 0; c < components; ++c)
+                        {
+                            if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE)
+                            {
+                                converted[i * components + c] = element[c] / 255.0f;
+                            }
+                            else
+                            {
+                                uint16_t value;
+                                memcpy(&value, element + c * sizeof(uint16_t), sizeof(uint16_t));
+                                converted[i * components + c] = value / 65535.0f;
+                            }
+                        }
+                    }
+                    return {converted.data(), components};
+                };
 
                 const tinygltf::Accessor& pos_accessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                const tinygltf::BufferView& pos_view = model.bufferViews[pos_accessor.bufferView];
-                pos_buffer = reinterpret_cast<const float*>(&(model.buffers[pos_view.buffer].data[pos_accessor.byteOffset + pos_view.byteOffset]));
-                pos_stride = pos_accessor.ByteStride(pos_view) ? (pos_accessor.ByteStride(pos_view) / sizeof(float)) : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-                if (primitive.attributes.find("NORMAL") != primitive.attributes.end())
-                {
-                    const tinygltf::Accessor& normal_accessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                    const tinygltf::BufferView& normal_view = model.bufferViews[normal_accessor.bufferView];
-                    normal_buffer = reinterpret_cast<const float*>(&(model.buffers[normal_view.buffer].data[normal_accessor.byteOffset + normal_view.byteOffset]));
-                    normal_stride = normal_accessor.ByteStride(normal_view) ? (normal_accessor.ByteStride(normal_view) / sizeof(float)) : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
-                }
-                if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end())
-                {
-                    const tinygltf::Accessor& tex_accessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                    const tinygltf::BufferView& tex_view = model.bufferViews[tex_accessor.bufferView];
-                    tex_buffer = reinterpret_cast<const float*>(&(model.buffers[tex_view.buffer].data[tex_accessor.byteOffset + tex_view.byteOffset]));
-                    tex_stride = tex_accessor.ByteStride(tex_view) ? (tex_accessor.ByteStride(tex_view) / sizeof(float)) : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC2);
-                }
+                VertexConversion::AttributeStream normal_stream = get_stream("NORMAL");
+                VE_ASSERT(normal_stream.data, "No normals in this model!");
+                uint32_t color_components = 4;
                 if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
                 {
-                    const tinygltf::Accessor& color_accessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-                    const tinygltf::BufferView& color_view = model.bufferViews[color_accessor.bufferView];
-                    color_buffer = reinterpret_cast<const float*>(&(model.buffers[color_view.buffer].data[color_accessor.byteOffset + color_view.byteOffset]));
-                    color_stride = color_accessor.ByteStride(color_view) ? (color_accessor.ByteStride(color_view) / sizeof(float)) : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
+                    color_components = tinygltf::GetNumComponentsInType(model.accessors[primitive.attributes.find("COLOR_0")->second].type);
                 }
 
-                for (size_t i = 0; i < pos_accessor.count; ++i)
-                {
-                    Vertex vertex;
-                    glm::vec4 tmp_pos = matrix * glm::vec4(glm::make_vec3(&pos_buffer[i * pos_stride]), 1.0f);
-                    vertex.pos = glm::vec3(tmp_pos.x / tmp_pos.w, tmp_pos.y / tmp_pos.w, tmp_pos.z / tmp_pos.w);
-                    VE_ASSERT(normal_buffer, "No normals in this model!");
-                    vertex.normal = glm::normalize(glm::make_vec3(&normal_buffer[i * normal_stride]));
-                    if (color_buffer)
-                    {
-                        vertex.color = glm::make_vec4(&color_buffer[i * color_stride]);
-                    }
-                    else if (primitive.material > -1 && mat->base_color.length() > 0.0f)
-                    {
-                        vertex.color = glm::vec4(mat->base_color);
-                    }
-                    else
-                    {
-                        vertex.color = glm::vec4(1.0f);
-                    }
-                    vertex.tex = tex_buffer ? glm::make_vec2(&tex_buffer[i * tex_stride]) : glm::vec2(-1.0f);
-                    vertices.push_back(vertex);
-                }
+                // convert whole attribute streams at once instead of assembling one vertex after another
+                vertices.resize(vertex_count + pos_accessor.count);
+                Vertex* primitive_vertices = vertices.data() + vertex_count;
+                VertexConversion::transform_positions(get_stream("POSITION"), pos_accessor.count, matrix, primitive_vertices);
+                VertexConversion::normalize_normals(normal_stream, pos_accessor.count, primitive_vertices);
+                VertexConversion::copy_colors(get_stream("COLOR_0"), color_components, pos_accessor.count, base_color, primitive_vertices);
+                VertexConversion::copy_tex_coords(get_stream("TEXCOORD_0"), pos_accessor.count, primitive_vertices);
             }
             // indices
             const tinygltf::Accessor& accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-            const tinygltf::BufferView& buffer_view = model.bufferViews[accessor.bufferView];
-            const void* raw_data = &(model.buffers[buffer_view.buffer].data[accessor.byteOffset + buffer_view.byteOffset]);
+            const void* raw_data = glb_file.get_accessor(model, primitive.indices > -1 ? primitive.indices : 0).data;
 
+            indices.resize(idx_count + accessor.count);
             auto add_indices([&](const auto* buf) -> void {
                 for (size_t i = 0; i < accessor.count; ++i)
                 {
-                    indices.push_back(buf[i] + vertex_count);
+                    indices[idx_count + i] = buf[i] + vertex_count;
                 }
             });
             switch (accessor.componentType)
@@ -262,8 +545,7 @@ namespace ve
                 default:
                     VE_THROW("Index component type " << accessor.componentType << " not supported!");
             }
-            vertex_count = vertices.size();
-            meshes.emplace_back(Mesh(vmc, vcc, mat, idx_count, indices.size() - idx_count));
+            model_data.meshes.push_back({primitive.material, idx_count, uint32_t(indices.size() - idx_count)});
         }
     }
 }// namespace ve
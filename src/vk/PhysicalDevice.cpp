@@ -9,7 +9,7 @@ namespace ve
     PhysicalDevice::PhysicalDevice(const Instance& instance, const std::optional<vk::SurfaceKHR>& surface)
     {
         const std::vector<const char*> required_extensions{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-        const std::vector<const char*> optional_extensions{VK_KHR_RAY_QUERY_EXTENSION_NAME, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME};
+        const std::vector<const char*> optional_extensions{VK_KHR_RAY_QUERY_EXTENSION_NAME, VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME, VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME, VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME};
         extensions_handler.add_extensions(required_extensions, true);
         extensions_handler.add_extensions(optional_extensions, false);
 
@@ -67,6 +67,17 @@ namespace ve
         return extensions_handler.get_missing_extensions();
     }
 
+    bool PhysicalDevice::is_extension_enabled(const char* extension) const
+    {
+        return extensions_handler.find_extension(extension);
+    }
+
+    bool PhysicalDevice::supports_descriptor_indexing() const
+    {
+        const auto features = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>().get<vk::PhysicalDeviceVulkan12Features>();
+        return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound && features.descriptorBindingVariableDescriptorCount && features.descriptorBindingSampledImageUpdateAfterBind;
+    }
+
     void PhysicalDevice::find_queue_families(const std::optional<vk::SurfaceKHR>& surface)
     {
         std::vector<vk::QueueFamilyProperties> queue_families = physical_device.getQueueFamilyProperties();
@@ -113,12 +124,14 @@ namespace ve
     {
         vk::PhysicalDeviceProperties pdp = p_device.getProperties();
         vk::PhysicalDeviceFeatures p_device_features = p_device.getFeatures();
+        // uploads are tracked with timeline semaphores
+        vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features> p_device_features_12 = p_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features>();
         std::vector<vk::ExtensionProperties> available_extensions = p_device.enumerateDeviceExtensionProperties();
         std::vector<const char*> avail_ext_names;
         for (const auto& ext: available_extensions) avail_ext_names.push_back(ext.extensionName);
         VE_TO_USER("    " << idx << " " << pdp.deviceName << " ");
         int32_t missing_extensions = extensions_handler.check_extension_availability(avail_ext_names);
-        if (missing_extensions == -1 || !p_device_features.samplerAnisotropy || (surface.has_value() && extensions_handler.find_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME) && !is_swapchain_supported(p_device, surface.value())))
+        if (missing_extensions == -1 || !p_device_features.samplerAnisotropy || !p_device_features_12.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore || (surface.has_value() && extensions_handler.find_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME) && !is_swapchain_supported(p_device, surface.value())))
         {
             VE_TO_USER("(not suitable)\n");
             return false;
@@ -16,8 +16,13 @@ namespace ve
         vmc.logical_device.get().destroyPipelineLayout(pipeline_layout);
     }
 
-    void Pipeline::construct(const RenderPass& render_pass, vk::DescriptorSetLayout set_layout, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode)
+    void Pipeline::construct(const RenderPass& render_pass, const std::vector<vk::DescriptorSetLayout>& set_layouts, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode, VertexFormat vertex_format)
     {
+        // the vertex shader decodes the attributes of quantized vertices if constant_id 0 is set
+        const vk::Bool32 quantized_vertices = vertex_format == VertexFormat::Quantized;
+        vk::SpecializationMapEntry sme(0, 0, sizeof(vk::Bool32));
+        vk::SpecializationInfo si(1, &sme, sizeof(vk::Bool32), &quantized_vertices);
+
         std::vector<Shader> shaders;
         std::vector<vk::PipelineShaderStageCreateInfo> shader_stages;
         for (const auto& shader_name: shader_names)
@@ -25,6 +30,7 @@ namespace ve
             Shader shader(vmc.logical_device.get(), shader_name.first, shader_name.second);
             shaders.push_back(shader);
             shader_stages.push_back(shader.get_stage_create_info());
+            if (shader_name.second == vk::ShaderStageFlagBits::eVertex) shader_stages.back().pSpecializationInfo = &si;
         }
 
         std::vector<vk::DynamicState> dynamic_states = {vk::DynamicState::eViewport, vk::DynamicState::eScissor};
@@ -33,8 +39,19 @@ namespace ve
         pdsci.dynamicStateCount = dynamic_states.size();
         pdsci.pDynamicStates = dynamic_states.data();
 
-        auto binding_description = Vertex::get_binding_description();
-        auto attribute_descriptions = Vertex::get_attribute_descriptions();
+        vk::VertexInputBindingDescription binding_description = Vertex::get_binding_description();
+        std::vector<vk::VertexInputAttributeDescription> attribute_descriptions;
+        if (vertex_format == VertexFormat::Quantized)
+        {
+            binding_description = QuantizedVertex::get_binding_description();
+            auto quantized_attribute_descriptions = QuantizedVertex::get_attribute_descriptions();
+            attribute_descriptions.assign(quantized_attribute_descriptions.begin(), quantized_attribute_descriptions.end());
+        }
+        else
+        {
+            auto full_attribute_descriptions = Vertex::get_attribute_descriptions();
+            attribute_descriptions.assign(full_attribute_descriptions.begin(), full_attribute_descriptions.end());
+        }
 
         vk::PipelineVertexInputStateCreateInfo pvisci{};
         pvisci.sType = vk::StructureType::ePipelineVertexInputStateCreateInfo;
@@ -114,12 +131,13 @@ namespace ve
         vk::PushConstantRange pcr;
         pcr.offset = 0;
         pcr.size = sizeof(PushConstants);
-        pcr.stageFlags = vk::ShaderStageFlagBits::eVertex;
+        // the material index of bindless pipelines is read by the fragment shader
+        pcr.stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment;
 
         vk::PipelineLayoutCreateInfo plci{};
         plci.sType = vk::StructureType::ePipelineLayoutCreateInfo;
-        plci.setLayoutCount = 1;
-        plci.pSetLayouts = &set_layout;
+        plci.setLayoutCount = set_layouts.size();
+        plci.pSetLayouts = set_layouts.data();
         plci.pushConstantRangeCount = 1;
         plci.pPushConstantRanges = &pcr;
 
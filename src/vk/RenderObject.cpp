@@ -1,8 +1,10 @@
 #include "vk/RenderObject.hpp"
 
+#include "vk/TextureCompressor.hpp"
+
 namespace ve
 {
-    RenderObject::RenderObject(const VulkanMainContext& vmc) : dsh(vmc), vmc(vmc), pipeline(vmc)
+    RenderObject::RenderObject(const VulkanMainContext& vmc) : frame_dsh(vmc), material_dsh(vmc), vmc(vmc), geometry_heap(vmc), pipeline(vmc), vertex_format(VertexFormat::Full)
     {}
 
     void RenderObject::self_destruct()
@@ -12,49 +14,129 @@ namespace ve
             model.self_destruct();
         }
         models.clear();
+        geometry_heap.self_destruct();
         pipeline.self_destruct();
-        dsh.self_destruct();
+        frame_dsh.self_destruct();
+        material_dsh.self_destruct();
     }
 
-    uint32_t RenderObject::add_model(VulkanCommandContext& vcc, const std::string& path)
+    void RenderObject::relocate(Defragmenter::Relocations& relocations)
     {
-        models.emplace_back(Model(vmc, vcc, path));
+        geometry_heap.relocate(relocations);
+        for (auto& model: models)
+        {
+            model.relocate(relocations);
+        }
+        frame_dsh.relocate(relocations);
+        material_dsh.relocate(relocations);
+    }
+
+    uint32_t RenderObject::add_model(VulkanCommandContext& vcc, UploadContext& upload, const std::string& path)
+    {
+        ImportOptions options;
+        options.vertex_format = vertex_format;
+        TextureImportOptions texture_options;
+        texture_options.compress = TextureCompressor::is_supported(vmc);
+        models.emplace_back(Model(vmc, vcc, upload, geometry_heap, Model::load_model_data(path, options, texture_options)));
+        upload_ticket = upload.get_ticket();
         return (models.size() - 1);
     }
 
-    uint32_t RenderObject::add_model(VulkanCommandContext& vcc, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material)
+    uint32_t RenderObject::add_model(VulkanCommandContext& vcc, UploadContext& upload, ModelData&& model_data)
     {
-        models.emplace_back(vmc, vcc, vertices, indices, material);
+        VE_ASSERT(model_data.vertex_format == vertex_format, "Vertex format of model \"" << model_data.name << "\" does not match the render object!");
+        models.emplace_back(Model(vmc, vcc, upload, geometry_heap, std::move(model_data)));
+        upload_ticket = upload.get_ticket();
         return (models.size() - 1);
     }
 
+    uint32_t RenderObject::add_model(VulkanCommandContext& vcc, UploadContext& upload, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const Material* material)
+    {
+        models.emplace_back(vmc, vcc, upload, geometry_heap, vertices, indices, material, vertex_format);
+        upload_ticket = upload.get_ticket();
+        return (models.size() - 1);
+    }
+
+    UploadTicket RenderObject::get_upload_ticket() const
+    {
+        return upload_ticket;
+    }
+
     Model* RenderObject::get_model(uint32_t idx)
     {
         return &models[idx];
     }
 
+    void RenderObject::set_vertex_format(VertexFormat format)
+    {
+        VE_ASSERT(models.empty(), "Cannot change the vertex format of a render object that already contains models!");
+        vertex_format = format;
+    }
+
+    VertexFormat RenderObject::get_vertex_format() const
+    {
+        return vertex_format;
+    }
+
+    void RenderObject::set_bindless_table(BindlessTable* table)
+    {
+        bindless_table = table;
+    }
+
+    void RenderObject::set_fallback_texture(const Image* texture)
+    {
+        fallback_texture = texture;
+    }
+
     void RenderObject::add_bindings()
+    {
+        frame_dsh.new_set();
+    }
+
+    void RenderObject::add_materials(BindlessTable& bindless_table)
     {
         for (auto& model: models)
         {
-            model.add_set_bindings(dsh);
+            model.add_materials(bindless_table);
         }
     }
 
     void RenderObject::construct(const RenderPass& render_pass, const std::vector<std::pair<std::string, vk::ShaderStageFlagBits>>& shader_names, vk::PolygonMode polygon_mode)
     {
         if (models.empty()) return;
-        dsh.construct();
-        pipeline.construct(render_pass, dsh.get_layouts()[0], shader_names, polygon_mode);
+        frame_dsh.construct();
+        std::vector<vk::DescriptorSetLayout> set_layouts = {frame_dsh.get_layout()};
+        if (bindless_table != nullptr)
+        {
+            set_layouts.push_back(bindless_table->get_layout());
+        }
+        else if (material_dsh.has_bindings())
+        {
+            VE_ASSERT(fallback_texture != nullptr, "Material sets require a fallback texture!");
+            std::unordered_map<const Material*, uint32_t> material_sets;
+            for (auto& model: models)
+            {
+                model.add_material_sets(material_dsh, material_sets, *fallback_texture);
+            }
+            material_dsh.construct();
+            set_layouts.push_back(material_dsh.get_layout());
+        }
+        pipeline.construct(render_pass, set_layouts, shader_names, polygon_mode, vertex_format);
     }
 
     void RenderObject::draw(vk::CommandBuffer& cb, uint32_t current_frame, const glm::mat4& vp)
     {
         if (models.empty()) return;
         cb.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+        geometry_heap.reset_binding();
+        frame_dsh.reset_binding();
+        material_dsh.reset_binding();
+        frame_dsh.bind(cb, pipeline.get_layout(), DescriptorSetFrequency::PerFrame, current_frame);
+        // one bind covers the materials of all meshes
+        if (bindless_table != nullptr) cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline.get_layout(), uint32_t(DescriptorSetFrequency::PerMaterial), bindless_table->get_set(), {});
         for (auto& model: models)
         {
-            model.draw(current_frame, pipeline.get_layout(), dsh.get_sets(), vp);
+            model.draw(current_frame, pipeline.get_layout(), material_dsh, vp);
         }
     }
 }// namespace ve
@@ -1,30 +1,62 @@
 #include "vk/Scene.hpp"
 
+#include <array>
+#include <deque>
 #include <fstream>
+#include <future>
+#include <thread>
 
 #include "json.hpp"
+#include "vk/TextureCompressor.hpp"
 
 namespace ve
 {
-    Scene::Scene(const VulkanMainContext& vmc, VulkanCommandContext& vcc) : vmc(vmc), vcc(vcc)
+    Scene::Scene(const VulkanMainContext& vmc, VulkanCommandContext& vcc, uint32_t frames_in_flight) : vmc(vmc), vcc(vcc), upload(vmc, vcc), defragmenter(vmc, vcc, frames_in_flight)
     {
         ros.emplace(ShaderFlavor::Default, vmc);
         ros.emplace(ShaderFlavor::Basic, vmc);
 
-        ros.at(ShaderFlavor::Default).dsh.add_binding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex);
-        ros.at(ShaderFlavor::Default).dsh.add_binding(1, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment);
+        ros.at(ShaderFlavor::Default).frame_dsh.add_binding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex);
+        if (BindlessTable::is_supported(vmc))
+        {
+            bindless_table.emplace(vmc);
+            ros.at(ShaderFlavor::Default).set_bindless_table(&bindless_table.value());
+        }
+        else
+        {
+            ros.at(ShaderFlavor::Default).material_dsh.add_binding(0, vk::DescriptorType::eCombinedImageSampler, vk::ShaderStageFlagBits::eFragment);
+            // recorded before any model, so acquiring the upload of a model also acquires the texture
+            const std::array<unsigned char, 4> white = {255, 255, 255, 255};
+            fallback_texture.emplace(vmc, upload, white.data(), 1, 1, false);
+            ros.at(ShaderFlavor::Default).set_fallback_texture(&fallback_texture.value());
+        }
+
+        ros.at(ShaderFlavor::Basic).frame_dsh.add_binding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex);
 
-        ros.at(ShaderFlavor::Basic).dsh.add_binding(0, vk::DescriptorType::eUniformBuffer, vk::ShaderStageFlagBits::eVertex);
+        // the material sets change between draws, pushing them saves the pool memory and the allocation of the sets
+        if (vmc.logical_device.supports_push_descriptors() && !bindless_table.has_value()) ros.at(ShaderFlavor::Default).material_dsh.use_push_descriptors();
     }
 
     void Scene::construct(const RenderPass& render_pass)
     {
-        ros.at(ShaderFlavor::Default).construct(render_pass, {std::make_pair("default.vert", vk::ShaderStageFlagBits::eVertex), std::make_pair("default.frag", vk::ShaderStageFlagBits::eFragment)}, vk::PolygonMode::eFill);
+        if (bindless_table.has_value())
+        {
+            ros.at(ShaderFlavor::Default).add_materials(bindless_table.value());
+            bindless_table.value().construct();
+        }
+        const std::string default_fragment_shader = bindless_table.has_value() ? "bindless.frag" : "default.frag";
+        ros.at(ShaderFlavor::Default).construct(render_pass, {std::make_pair("default.vert", vk::ShaderStageFlagBits::eVertex), std::make_pair(default_fragment_shader, vk::ShaderStageFlagBits::eFragment)}, vk::PolygonMode::eFill);
         ros.at(ShaderFlavor::Basic).construct(render_pass, {std::make_pair("default.vert", vk::ShaderStageFlagBits::eVertex), std::make_pair("basic.frag", vk::ShaderStageFlagBits::eFragment)}, vk::PolygonMode::eFill);
     }
 
     void Scene::self_destruct()
     {
+        finish_defragmentation();
+        defragmenter.self_destruct();
+        upload.self_destruct();
+        if (bindless_table.has_value()) bindless_table.value().self_destruct();
+        if (fallback_texture.has_value()) fallback_texture.value().self_destruct();
+        fallback_texture.reset();
         for (auto& image: images)
         {
             image.self_destruct();
@@ -37,22 +69,77 @@ namespace ve
         ros.clear();
     }
 
-    void Scene::load(const std::string& path)
+    void Scene::load(const std::string& path, bool parallel)
     {
+        finish_defragmentation();
         // load scene from custom json file
         using json = nlohmann::json;
         std::ifstream file(path);
         json data = json::parse(file);
+        auto get_shader_flavor = [](const json& d) -> ShaderFlavor {
+            ShaderFlavor flavor = ShaderFlavor::Default;
+            if (d.value("ShaderFlavor", "") == "Basic") flavor = ShaderFlavor::Basic;
+            if (d.value("ShaderFlavor", "") == "Default") flavor = ShaderFlavor::Default;
+            return flavor;
+        };
+        // vertex formats of the render objects, e.g. "vertex_formats": {"Basic": "Quantized"}
+        if (data.contains("vertex_formats"))
+        {
+            for (auto& [flavor_name, format_name]: data["vertex_formats"].items())
+            {
+                ShaderFlavor flavor = flavor_name == "Basic" ? ShaderFlavor::Basic : ShaderFlavor::Default;
+                ros.at(flavor).set_vertex_format(format_name == "Quantized" ? VertexFormat::Quantized : VertexFormat::Full);
+            }
+        }
         if (data.contains("model_files"))
         {
+            const json& model_files = data["model_files"];
+            auto get_model_path = [](const json& d) -> std::string { return std::string("../assets/models/") + std::string(d.value("file", "")); };
+            auto get_import_options = [&](const json& d) -> ImportOptions {
+                ImportOptions options;
+                options.overdraw_threshold = d.value("overdraw_threshold", 0.0f);
+                options.vertex_format = ros.at(get_shader_flavor(d)).get_vertex_format();
+                return options;
+            };
+            TextureImportOptions texture_options;
+            texture_options.compress = TextureCompressor::is_supported(vmc);
+            // texture quality budgets per role, e.g. "texture_budgets": {"Normal": {"max_resolution": 1024, "mip_bias": 0}}
+            if (data.contains("texture_budgets"))
+            {
+                const std::array<std::string, texture_role_count> role_names = {"BaseColor", "MetallicRoughness", "Normal", "Emissive", "Occlusion"};
+                for (uint32_t i = 0; i < texture_role_count; ++i)
+                {
+                    if (!data["texture_budgets"].contains(role_names[i])) continue;
+                    const json& budget = data["texture_budgets"][role_names[i]];
+                    texture_options.budgets[i].max_resolution = budget.value("max_resolution", texture_options.budgets[i].max_resolution);
+                    texture_options.budgets[i].mip_bias = budget.value("mip_bias", texture_options.budgets[i].mip_bias);
+                }
+            }
+            // parse and convert the next model files on worker threads while the finished ones are uploaded in scene order
+            // the number of models in flight is limited to keep the host memory of not yet uploaded models bounded
+            const uint32_t max_pending = std::max(1u, std::thread::hardware_concurrency());
+            std::deque<std::future<ModelData>> pending_models;
+            uint32_t next_model = 0;
             // load referenced model files
-            for (auto& d: data["model_files"])
+            for (auto& d: model_files)
             {
-                ShaderFlavor flavor;
-                if (d.value("ShaderFlavor", "") == "Basic") flavor = ShaderFlavor::Basic;
-                if (d.value("ShaderFlavor", "") == "Default") flavor = ShaderFlavor::Default;
+                ShaderFlavor flavor = get_shader_flavor(d);
                 std::string name = d.value("name", "");
-                add_model(name, ModelHandle(flavor, std::string("../assets/models/") + std::string(d.value("file", ""))));
+                if (parallel)
+                {
+                    while (next_model < model_files.size() && pending_models.size() < max_pending)
+                    {
+                        const json& next = model_files[next_model++];
+                        pending_models.push_back(std::async(std::launch::async, &Model::load_model_data, get_model_path(next), get_import_options(next), texture_options));
+                    }
+                    ModelData model_data = pending_models.front().get();
+                    pending_models.pop_front();
+                    add_model(name, ModelHandle(flavor, get_model_path(d)), std::move(model_data));
+                }
+                else
+                {
+                    add_model(name, ModelHandle(flavor, get_model_path(d)), Model::load_model_data(get_model_path(d), get_import_options(d), texture_options));
+                }
 
                 if (d.contains("scale"))
                 {
@@ -76,9 +163,7 @@ namespace ve
         {
             for (auto& d: data["custom_models"])
             {
-                ShaderFlavor flavor;
-                if (d.value("ShaderFlavor", "") == "Basic") flavor = ShaderFlavor::Basic;
-                if (d.value("ShaderFlavor", "") == "Default") flavor = ShaderFlavor::Default;
+                ShaderFlavor flavor = get_shader_flavor(d);
                 std::string name = d.value("name", "");
                 std::vector<Vertex> vertices;
                 std::vector<uint32_t> indices;
@@ -95,32 +180,47 @@ namespace ve
                 {
                     indices.push_back(i);
                 }
-                Material m;
+                Material m{};
                 if (d.contains("base_texture"))
                 {
-                    images.emplace_back(Image(vmc, vcc, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, std::string("../assets/textures/") + std::string(d.value("base_texture", "")), true));
+                    images.emplace_back(Image(vmc, upload, std::string("../assets/textures/") + std::string(d.value("base_texture", "")), true));
                     m.base_texture = &images.back();
                 }
                 materials.push_back(m);
                 add_model(name, ModelHandle(flavor, &vertices, &indices, &materials.back()));
             }
         }
+        // the transfers run while the scene is constructed, the first frame acquires them
+        submit_uploads();
     }
 
     void Scene::add_model(const std::string& key, ModelHandle model_handle)
     {
+        finish_defragmentation();
         if (model_handle.shader_flavor == ShaderFlavor::Basic) model_handle.material = nullptr;
         if (model_handle.filename != "none")
         {
-            model_handle.idx = ros.at(model_handle.shader_flavor).add_model(vcc, model_handle.filename);
+            model_handle.idx = ros.at(model_handle.shader_flavor).add_model(vcc, upload, model_handle.filename);
         }
         else
         {
-            model_handle.idx = ros.at(model_handle.shader_flavor).add_model(vcc, *model_handle.vertices, *model_handle.indices, model_handle.material);
+            model_handle.idx = ros.at(model_handle.shader_flavor).add_model(vcc, upload, *model_handle.vertices, *model_handle.indices, model_handle.material);
         }
         model_handles.emplace(key, model_handle);
     }
 
+    void Scene::add_model(const std::string& key, ModelHandle model_handle, ModelData&& model_data)
+    {
+        finish_defragmentation();
+        model_handle.idx = ros.at(model_handle.shader_flavor).add_model(vcc, upload, std::move(model_data));
+        model_handles.emplace(key, model_handle);
+    }
+
+    UploadTicket Scene::submit_uploads()
+    {
+        return upload.submit();
+    }
+
     void Scene::add_bindings()
     {
         for (auto& ro: ros)
@@ -167,15 +267,45 @@ namespace ve
 
     DescriptorSetHandler& Scene::get_dsh(ShaderFlavor flavor)
     {
-        return ros.at(flavor).dsh;
+        return ros.at(flavor).frame_dsh;
+    }
+
+    void Scene::update_defragmentation()
+    {
+        std::optional<Defragmenter::Relocations> relocations = defragmenter.update(upload.is_idle());
+        if (relocations.has_value()) relocate(relocations.value());
     }
 
     void Scene::draw(vk::CommandBuffer& cb, uint32_t current_frame, const glm::mat4& vp)
     {
         for (auto& ro: ros)
         {
+            // only the first frame that draws newly added models waits for their transfers
+            upload.acquire(ro.second.get_upload_ticket());
             ro.second.draw(cb, current_frame, vp);
         }
     }
 
+    void Scene::finish_defragmentation()
+    {
+        std::optional<Defragmenter::Relocations> relocations = defragmenter.finish();
+        if (relocations.has_value()) relocate(relocations.value());
+    }
+
+    void Scene::relocate(Defragmenter::Relocations& relocations)
+    {
+        // images of custom models may be used by materials of any render object
+        for (auto& image: images)
+        {
+            image.relocate(relocations);
+        }
+        if (fallback_texture.has_value()) fallback_texture.value().relocate(relocations);
+        for (auto& ro: ros)
+        {
+            ro.second.relocate(relocations);
+        }
+        if (bindless_table.has_value()) bindless_table.value().relocate(relocations);
+        const Defragmenter::Stats& stats = defragmenter.get_stats();
+        VE_LOG_CONSOLE(VE_DEBUG, "Relocated " << relocations.buffers.size() << " buffers and " << relocations.images.size() << " images, " << stats.bytes_freed / (1024 * 1024) << " MiB reclaimed so far\n");
+    }
 }// namespace ve
@@ -0,0 +1,59 @@
+#include "vk/StagingRing.hpp"
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    StagingRing::StagingRing(const VulkanMainContext& vmc, vk::DeviceSize size) : vmc(vmc), size(size)
+    {
+        vk::BufferCreateInfo bci{};
+        bci.sType = vk::StructureType::eBufferCreateInfo;
+        bci.size = size;
+        bci.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        bci.sharingMode = vk::SharingMode::eExclusive;
+        VmaAllocationInfo vai;
+        std::tie(buffer, vmaa) = vmc.memory_pools.create_buffer(bci, AllocationClass::Staging, VMA_ALLOCATION_CREATE_MAPPED_BIT, &vai);
+        mapped = static_cast<unsigned char*>(vai.pMappedData);
+    }
+
+    std::optional<StagingRing::Allocation> StagingRing::allocate(vk::DeviceSize allocation_size, vk::DeviceSize alignment)
+    {
+        if (allocation_size > size) return std::nullopt;
+        uint64_t start = (head + alignment - 1) / alignment * alignment;
+        // allocations are not split at the end of the buffer
+        if (start % size + allocation_size > size) start = (start / size + 1) * size;
+        if (start + allocation_size - tail > size) return std::nullopt;
+        head = start + allocation_size;
+        return Allocation{buffer, start % size, mapped + start % size};
+    }
+
+    void StagingRing::flush(const Allocation& allocation, vk::DeviceSize flush_size) const
+    {
+        vmaFlushAllocation(vmc.va, vmaa, allocation.offset, flush_size);
+    }
+
+    void StagingRing::submit(uint64_t value)
+    {
+        if (head > (submissions.empty() ? tail : submissions.back().second)) submissions.push_back(std::make_pair(value, head));
+    }
+
+    void StagingRing::release(uint64_t completed_value)
+    {
+        while (!submissions.empty() && submissions.front().first <= completed_value)
+        {
+            tail = submissions.front().second;
+            submissions.pop_front();
+        }
+    }
+
+    vk::DeviceSize StagingRing::get_size() const
+    {
+        return size;
+    }
+
+    void StagingRing::self_destruct()
+    {
+        vmc.memory_pools.destroy_buffer(buffer, vmaa);
+        submissions.clear();
+    }
+}// namespace ve
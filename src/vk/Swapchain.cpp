@@ -36,11 +36,11 @@ namespace ve
         choose_extent(capabilities);
         uint32_t image_count = capabilities.maxImageCount > 0 ? std::min(capabilities.minImageCount + 1, capabilities.maxImageCount) : capabilities.minImageCount + 1;
 
-        depth_buffer.create_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eDepthStencilAttachment, depth_format, extent.width, extent.height, render_pass.get_sample_count());
+        depth_buffer.create_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eDepthStencilAttachment, depth_format, extent.width, extent.height, render_pass.get_sample_count(), AllocationClass::Attachment);
         depth_buffer.create_image_view(depth_format, vk::ImageAspectFlagBits::eDepth);
         if (render_pass.get_sample_count() != vk::SampleCountFlagBits::e1)
         {
-            color_image.create_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, surface_format.format, extent.width, extent.height, render_pass.get_sample_count());
+            color_image.create_image({uint32_t(vmc.queues_family_indices.graphics)}, vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, surface_format.format, extent.width, extent.height, render_pass.get_sample_count(), AllocationClass::Attachment);
             color_image.create_image_view(surface_format.format, vk::ImageAspectFlagBits::eColor);
         }
 
@@ -0,0 +1,503 @@
+#include "vk/TextureCompressor.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include "ve_log.hpp"
+#include "vk/MeshCache.hpp"
+#include "vk/Model.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        constexpr uint32_t block_texels = 16;
+        // interpolation weights of the 4 bit indices of BC7
+        constexpr std::array<uint32_t, 16> bc7_weights = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // principal axis of the texels of a block with the given number of channels, the result is written to mean and axis
+        template<uint32_t N>
+        void find_principal_axis(const unsigned char* rgba, std::array<float, N>& mean, std::array<float, N>& axis)
+        {
+            mean.fill(0.0f);
+            for (uint32_t i = 0; i < block_texels; ++i)
+            {
+                for (uint32_t c = 0; c < N; ++c) mean[c] += rgba[i * 4 + c];
+            }
+            for (uint32_t c = 0; c < N; ++c) mean[c] /= float(block_texels);
+            std::array<float, N * N> covariance{};
+            for (uint32_t i = 0; i < block_texels; ++i)
+            {
+                for (uint32_t r = 0; r < N; ++r)
+                {
+                    for (uint32_t c = 0; c < N; ++c) covariance[r * N + c] += (rgba[i * 4 + r] - mean[r]) * (rgba[i * 4 + c] - mean[c]);
+                }
+            }
+            // power iteration converges quickly for the dominant eigenvector of the covariance matrix
+            axis.fill(1.0f);
+            for (uint32_t iteration = 0; iteration < 8; ++iteration)
+            {
+                std::array<float, N> next{};
+                for (uint32_t r = 0; r < N; ++r)
+                {
+                    for (uint32_t c = 0; c < N; ++c) next[r] += covariance[r * N + c] * axis[c];
+                }
+                float length = 0.0f;
+                for (uint32_t c = 0; c < N; ++c) length += next[c] * next[c];
+                if (length < 1e-12f) break;
+                length = std::sqrt(length);
+                for (uint32_t c = 0; c < N; ++c) axis[c] = next[c] / length;
+            }
+        }
+
+        // endpoints at the extremes of the projection of the texels onto the principal axis
+        template<uint32_t N>
+        void find_endpoints(const unsigned char* rgba, std::array<float, N>& e0, std::array<float, N>& e1)
+        {
+            std::array<float, N> mean;
+            std::array<float, N> axis;
+            find_principal_axis<N>(rgba, mean, axis);
+            float min_t = 0.0f;
+            float max_t = 0.0f;
+            for (uint32_t i = 0; i < block_texels; ++i)
+            {
+                float t = 0.0f;
+                for (uint32_t c = 0; c < N; ++c) t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+                min_t = std::min(min_t, t);
+                max_t = std::max(max_t, t);
+            }
+            for (uint32_t c = 0; c < N; ++c)
+            {
+                e0[c] = std::clamp(mean[c] + axis[c] * max_t, 0.0f, 255.0f);
+                e1[c] = std::clamp(mean[c] + axis[c] * min_t, 0.0f, 255.0f);
+            }
+        }
+
+        uint16_t pack_565(const std::array<float, 3>& color)
+        {
+            const uint32_t r = uint32_t(std::round(color[0] * 31.0f / 255.0f));
+            const uint32_t g = uint32_t(std::round(color[1] * 63.0f / 255.0f));
+            const uint32_t b = uint32_t(std::round(color[2] * 31.0f / 255.0f));
+            return uint16_t((r << 11) | (g << 5) | b);
+        }
+
+        std::array<int32_t, 3> unpack_565(uint16_t color)
+        {
+            const int32_t r = (color >> 11) & 31;
+            const int32_t g = (color >> 5) & 63;
+            const int32_t b = color & 31;
+            return {(r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2)};
+        }
+
+        uint32_t texel_distance(const unsigned char* texel, const int32_t* color, uint32_t channels)
+        {
+            uint32_t distance = 0;
+            for (uint32_t c = 0; c < channels; ++c) distance += (texel[c] - color[c]) * (texel[c] - color[c]);
+            return distance;
+        }
+
+        // writes the lowest bit_count bits of value to the bit stream of a block
+        void write_bits(unsigned char* block, uint32_t& bit_offset, uint32_t value, uint32_t bit_count)
+        {
+            for (uint32_t i = 0; i < bit_count; ++i, ++bit_offset)
+            {
+                if (value & (1u << i)) block[bit_offset / 8] |= uint8_t(1u << (bit_offset % 8));
+            }
+        }
+
+        float srgb_to_linear(float c)
+        {
+            return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float linear_to_srgb(float c)
+        {
+            return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        }
+    }// namespace
+
+    bool TextureCompressor::is_supported(const VulkanMainContext& vmc)
+    {
+        return vmc.physical_device.get().getFeatures().textureCompressionBC;
+    }
+
+    vk::Format TextureCompressor::get_format(TextureRole role, bool has_alpha)
+    {
+        switch (role)
+        {
+            // BC7 gives the best quality for opaque colors, BC3 keeps sharp alpha edges of cutouts
+            case TextureRole::BaseColor:
+                return has_alpha ? vk::Format::eBc3SrgbBlock : vk::Format::eBc7SrgbBlock;
+            // two independent channels for x and y, a shader sampling the normal map has to reconstruct z = sqrt(1 - x^2 - y^2)
+            case TextureRole::Normal:
+                return vk::Format::eBc5UnormBlock;
+            case TextureRole::Emissive:
+                return vk::Format::eBc1RgbSrgbBlock;
+            case TextureRole::MetallicRoughness:
+            case TextureRole::Occlusion:
+            default:
+                return vk::Format::eBc1RgbUnormBlock;
+        }
+    }
+
+    std::vector<std::optional<TextureRole>> TextureCompressor::get_texture_roles(const tinygltf::Model& model)
+    {
+        std::vector<std::optional<TextureRole>> roles(model.textures.size());
+        auto set_role = [&](int texture_idx, TextureRole role) {
+            if (texture_idx > -1 && texture_idx < int(roles.size()) && !roles[texture_idx].has_value()) roles[texture_idx] = role;
+        };
+        // the texture slots that are read by Model::load_material
+        for (const auto& mat: model.materials)
+        {
+            set_role(mat.pbrMetallicRoughness.baseColorTexture.index, TextureRole::BaseColor);
+            set_role(mat.pbrMetallicRoughness.metallicRoughnessTexture.index, TextureRole::MetallicRoughness);
+            set_role(mat.normalTexture.index, TextureRole::Normal);
+            set_role(mat.emissiveTexture.index, TextureRole::Emissive);
+            set_role(mat.occlusionTexture.index, TextureRole::Occlusion);
+        }
+        return roles;
+    }
+
+    bool TextureCompressor::is_srgb(TextureRole role)
+    {
+        return role == TextureRole::BaseColor || role == TextureRole::Emissive;
+    }
+
+    Ktx2Texture TextureCompressor::compress(const unsigned char* rgba, uint32_t width, uint32_t height, vk::Format format)
+    {
+        void (*encode_block)(const unsigned char*, unsigned char*) = nullptr;
+        switch (format)
+        {
+            case vk::Format::eBc1RgbUnormBlock:
+            case vk::Format::eBc1RgbSrgbBlock:
+                encode_block = &encode_bc1_block;
+                break;
+            case vk::Format::eBc3UnormBlock:
+            case vk::Format::eBc3SrgbBlock:
+                encode_block = &encode_bc3_block;
+                break;
+            case vk::Format::eBc5UnormBlock:
+                encode_block = &encode_bc5_block;
+                break;
+            case vk::Format::eBc7UnormBlock:
+            case vk::Format::eBc7SrgbBlock:
+                encode_block = &encode_bc7_block;
+                break;
+            default:
+                VE_THROW("Texture format " << vk::to_string(format) << " is not supported by the texture compressor!");
+        }
+        const bool srgb = format == vk::Format::eBc1RgbSrgbBlock || format == vk::Format::eBc3SrgbBlock || format == vk::Format::eBc7SrgbBlock;
+        const uint32_t block_size = Ktx2Texture::get_block_size(format);
+
+        std::vector<std::vector<unsigned char>> levels;
+        std::vector<unsigned char> level_rgba(rgba, rgba + std::size_t(width) * height * 4);
+        uint32_t level_width = width;
+        uint32_t level_height = height;
+        while (true)
+        {
+            const uint32_t blocks_x = (level_width + 3) / 4;
+            const uint32_t blocks_y = (level_height + 3) / 4;
+            std::vector<unsigned char>& level = levels.emplace_back(std::size_t(blocks_x) * blocks_y * block_size);
+            std::array<unsigned char, block_texels * 4> block_rgba;
+            for (uint32_t by = 0; by < blocks_y; ++by)
+            {
+                for (uint32_t bx = 0; bx < blocks_x; ++bx)
+                {
+                    // texels outside of the image repeat the last row and column
+                    for (uint32_t y = 0; y < 4; ++y)
+                    {
+                        for (uint32_t x = 0; x < 4; ++x)
+                        {
+                            const uint32_t sx = std::min(bx * 4 + x, level_width - 1);
+                            const uint32_t sy = std::min(by * 4 + y, level_height - 1);
+                            memcpy(&block_rgba[(y * 4 + x) * 4], &level_rgba[(std::size_t(sy) * level_width + sx) * 4], 4);
+                        }
+                    }
+                    encode_block(block_rgba.data(), &level[(std::size_t(by) * blocks_x + bx) * block_size]);
+                }
+            }
+            if (level_width == 1 && level_height == 1) break;
+            level_rgba = downsample(level_rgba, level_width, level_height, srgb);
+            level_width = std::max(1u, level_width / 2);
+            level_height = std::max(1u, level_height / 2);
+        }
+        return Ktx2Texture(format, width, height, levels);
+    }
+
+    void TextureCompressor::compress_textures(ModelData& model_data)
+    {
+        tinygltf::Model& model = model_data.gltf_model;
+        const std::vector<std::optional<TextureRole>> roles = get_texture_roles(model);
+
+        // the cache is keyed by the encoded image files, so cached textures never have to be decoded
+        std::vector<uint64_t> image_hashes(model.images.size(), 0);
+        for (uint32_t i = 0; i < model.images.size() && i < model_data.encoded_images.size(); ++i)
+        {
+            if (!model_data.encoded_images[i].empty()) image_hashes[i] = MeshCache::hash(model_data.encoded_images[i].data(), model_data.encoded_images[i].size());
+        }
+
+        std::error_code ec;
+        std::filesystem::create_directories(MeshCache::cache_dir, ec);
+        model_data.compressed_textures.resize(model.textures.size());
+        for (uint32_t i = 0; i < model.textures.size(); ++i)
+        {
+            const int source = model.textures[i].source;
+            if (!roles[i].has_value() || source < 0 || image_hashes[source] == 0) continue;
+            const TextureRole role = roles[i].value();
+            std::stringstream cache_path;
+            cache_path << MeshCache::cache_dir << std::hex << (image_hashes[source] ^ uint64_t(role)) << ".ktx2";
+            Ktx2Texture texture(cache_path.str());
+            const bool valid_format = texture.get_format() == get_format(role, false) || texture.get_format() == get_format(role, true);
+            if (!texture.is_valid() || !valid_format || texture.get_width() != uint32_t(model.images[source].width) || texture.get_height() != uint32_t(model.images[source].height))
+            {
+                const tinygltf::Image& image = model_data.wait_for_image(source);
+                bool has_alpha = false;
+                for (std::size_t p = 3; p < image.image.size() && !has_alpha; p += 4) has_alpha = image.image[p] < 255;
+                const vk::Format format = get_format(role, has_alpha);
+                texture = compress(image.image.data(), image.width, image.height, format);
+                // write to a temporary file first so that concurrent loaders never map a partially written texture
+                std::stringstream tmp_path;
+                tmp_path << cache_path.str() << ".tmp" << std::this_thread::get_id();
+                if (texture.write(tmp_path.str())) std::filesystem::rename(tmp_path.str(), cache_path.str(), ec);
+                if (ec) std::filesystem::remove(tmp_path.str(), ec);
+                VE_LOG_CONSOLE(VE_INFO, "Compressed texture " << i << " of \"" << model_data.name << "\" to " << vk::to_string(format) << "\n");
+            }
+            model_data.compressed_textures[i].emplace(std::move(texture));
+        }
+
+        // neither the encoded nor the decoded pixels of images that are only used by compressed textures are needed anymore
+        std::vector<bool> image_needed(model.images.size(), false);
+        for (uint32_t i = 0; i < model.textures.size(); ++i)
+        {
+            if (model.textures[i].source > -1 && !model_data.compressed_textures[i].has_value()) image_needed[model.textures[i].source] = true;
+        }
+        for (uint32_t i = 0; i < model.images.size(); ++i)
+        {
+            if (image_needed[i]) continue;
+            model.images[i].image.clear();
+            model.images[i].image.shrink_to_fit();
+            if (i < model_data.encoded_images.size()) model_data.encoded_images[i] = {};
+        }
+    }
+
+    void TextureCompressor::encode_bc1_block(const unsigned char* rgba, unsigned char* block)
+    {
+        encode_bc1_color(rgba, block);
+    }
+
+    void TextureCompressor::encode_bc3_block(const unsigned char* rgba, unsigned char* block)
+    {
+        encode_bc4_channel(rgba, 3, block);
+        encode_bc1_color(rgba, block + 8);
+    }
+
+    void TextureCompressor::encode_bc5_block(const unsigned char* rgba, unsigned char* block)
+    {
+        encode_bc4_channel(rgba, 0, block);
+        encode_bc4_channel(rgba, 1, block + 8);
+    }
+
+    void TextureCompressor::encode_bc7_block(const unsigned char* rgba, unsigned char* block)
+    {
+        // mode 6: a single subset with RGBA endpoints of 7 bits plus a shared lowest bit per endpoint and 4 bit indices
+        std::array<float, 4> e0;
+        std::array<float, 4> e1;
+        find_endpoints<4>(rgba, e0, e1);
+        std::array<std::array<int32_t, 4>, 2> endpoints;
+        std::array<uint32_t, 2> p_bits;
+        for (uint32_t e = 0; e < 2; ++e)
+        {
+            const std::array<float, 4>& endpoint = e == 0 ? e0 : e1;
+            // choose the p-bit that reproduces the endpoint best
+            float best_error = std::numeric_limits<float>::max();
+            for (uint32_t p = 0; p < 2; ++p)
+            {
+                std::array<int32_t, 4> quantized;
+                float error = 0.0f;
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    quantized[c] = std::clamp(int32_t(std::round((endpoint[c] - float(p)) / 2.0f)), 0, 127);
+                    const float reconstructed = float((quantized[c] << 1) | p);
+                    error += (reconstructed - endpoint[c]) * (reconstructed - endpoint[c]);
+                }
+                if (error < best_error)
+                {
+                    best_error = error;
+                    endpoints[e] = quantized;
+                    p_bits[e] = p;
+                }
+            }
+        }
+
+        std::array<std::array<int32_t, 4>, 16> palette;
+        for (uint32_t i = 0; i < 16; ++i)
+        {
+            for (uint32_t c = 0; c < 4; ++c)
+            {
+                const int32_t v0 = (endpoints[0][c] << 1) | p_bits[0];
+                const int32_t v1 = (endpoints[1][c] << 1) | p_bits[1];
+                palette[i][c] = ((64 - bc7_weights[i]) * v0 + bc7_weights[i] * v1 + 32) >> 6;
+            }
+        }
+        std::array<uint32_t, block_texels> indices;
+        for (uint32_t i = 0; i < block_texels; ++i)
+        {
+            uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+            for (uint32_t j = 0; j < 16; ++j)
+            {
+                const uint32_t distance = texel_distance(&rgba[i * 4], palette[j].data(), 4);
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    indices[i] = j;
+                }
+            }
+        }
+        // the highest bit of the index of the first texel is implicitly 0
+        if (indices[0] >= 8)
+        {
+            std::swap(endpoints[0], endpoints[1]);
+            std::swap(p_bits[0], p_bits[1]);
+            for (auto& index: indices) index = 15 - index;
+        }
+
+        memset(block, 0, 16);
+        uint32_t bit_offset = 0;
+        write_bits(block, bit_offset, 1u << 6, 7);
+        for (uint32_t c = 0; c < 4; ++c)
+        {
+            write_bits(block, bit_offset, endpoints[0][c], 7);
+            write_bits(block, bit_offset, endpoints[1][c], 7);
+        }
+        write_bits(block, bit_offset, p_bits[0], 1);
+        write_bits(block, bit_offset, p_bits[1], 1);
+        for (uint32_t i = 0; i < block_texels; ++i) write_bits(block, bit_offset, indices[i], i == 0 ? 3 : 4);
+    }
+
+    void TextureCompressor::encode_bc1_color(const unsigned char* rgba, unsigned char* block)
+    {
+        std::array<float, 3> e0;
+        std::array<float, 3> e1;
+        find_endpoints<3>(rgba, e0, e1);
+        // move the endpoints slightly inwards, the extremes are usually outliers
+        for (uint32_t c = 0; c < 3; ++c)
+        {
+            const float inset = (e0[c] - e1[c]) / 16.0f;
+            e0[c] -= inset;
+            e1[c] += inset;
+        }
+        uint16_t c0 = pack_565(e0);
+        uint16_t c1 = pack_565(e1);
+        // the four color mode requires c0 > c1
+        if (c0 < c1) std::swap(c0, c1);
+
+        uint32_t index_bits = 0;
+        if (c0 != c1)
+        {
+            const std::array<int32_t, 3> p0 = unpack_565(c0);
+            const std::array<int32_t, 3> p1 = unpack_565(c1);
+            std::array<std::array<int32_t, 3>, 4> palette;
+            palette[0] = p0;
+            palette[1] = p1;
+            for (uint32_t c = 0; c < 3; ++c)
+            {
+                palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+                palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+            }
+            for (uint32_t i = 0; i < block_texels; ++i)
+            {
+                uint32_t best_index = 0;
+                uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+                for (uint32_t j = 0; j < 4; ++j)
+                {
+                    const uint32_t distance = texel_distance(&rgba[i * 4], palette[j].data(), 3);
+                    if (distance < best_distance)
+                    {
+                        best_distance = distance;
+                        best_index = j;
+                    }
+                }
+                index_bits |= best_index << (i * 2);
+            }
+        }
+        memcpy(block, &c0, sizeof(uint16_t));
+        memcpy(block + 2, &c1, sizeof(uint16_t));
+        memcpy(block + 4, &index_bits, sizeof(uint32_t));
+    }
+
+    void TextureCompressor::encode_bc4_channel(const unsigned char* rgba, uint32_t channel, unsigned char* block)
+    {
+        uint8_t a0 = 0;
+        uint8_t a1 = 255;
+        for (uint32_t i = 0; i < block_texels; ++i)
+        {
+            a0 = std::max(a0, rgba[i * 4 + channel]);
+            a1 = std::min(a1, rgba[i * 4 + channel]);
+        }
+        memset(block, 0, 8);
+        block[0] = a0;
+        block[1] = a1;
+        // a0 > a1 selects the mode with eight interpolated values, if both are equal every index refers to a0
+        if (a0 == a1) return;
+        std::array<int32_t, 8> palette = {a0, a1};
+        for (uint32_t i = 1; i < 7; ++i) palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+        uint32_t bit_offset = 16;
+        for (uint32_t i = 0; i < block_texels; ++i)
+        {
+            uint32_t best_index = 0;
+            uint32_t best_distance = std::numeric_limits<uint32_t>::max();
+            for (uint32_t j = 0; j < 8; ++j)
+            {
+                const uint32_t distance = texel_distance(&rgba[i * 4 + channel], &palette[j], 1);
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    best_index = j;
+                }
+            }
+            write_bits(block, bit_offset, best_index, 3);
+        }
+    }
+
+    std::vector<unsigned char> TextureCompressor::downsample(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height, bool srgb)
+    {
+        // 2x2 box filter, colors of sRGB textures are averaged in linear space
+        std::array<float, 256> to_linear;
+        for (uint32_t i = 0; i < 256; ++i) to_linear[i] = srgb ? srgb_to_linear(i / 255.0f) : i / 255.0f;
+        const uint32_t new_width = std::max(1u, width / 2);
+        const uint32_t new_height = std::max(1u, height / 2);
+        std::vector<unsigned char> result(std::size_t(new_width) * new_height * 4);
+        for (uint32_t y = 0; y < new_height; ++y)
+        {
+            for (uint32_t x = 0; x < new_width; ++x)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    float sum = 0.0f;
+                    for (uint32_t dy = 0; dy < 2; ++dy)
+                    {
+                        for (uint32_t dx = 0; dx < 2; ++dx)
+                        {
+                            const uint32_t sx = std::min(x * 2 + dx, width - 1);
+                            const uint32_t sy = std::min(y * 2 + dy, height - 1);
+                            const unsigned char value = rgba[(std::size_t(sy) * width + sx) * 4 + c];
+                            // alpha is always linear
+                            sum += c == 3 ? value / 255.0f : to_linear[value];
+                        }
+                    }
+                    const float average = sum / 4.0f;
+                    const float encoded = (c == 3 || !srgb) ? average : linear_to_srgb(average);
+                    result[(std::size_t(y) * new_width + x) * 4 + c] = uint8_t(std::clamp(std::round(encoded * 255.0f), 0.0f, 255.0f));
+                }
+            }
+        }
+        return result;
+    }
+}// namespace ve
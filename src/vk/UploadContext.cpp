@@ -0,0 +1,284 @@
+#include "vk/UploadContext.hpp"
+
+#include <cstring>
+
+#include "ve_log.hpp"
+
+namespace ve
+{
+    namespace
+    {
+        vk::Semaphore create_timeline_semaphore(const vk::Device& device)
+        {
+            vk::SemaphoreTypeCreateInfo stci{};
+            stci.sType = vk::StructureType::eSemaphoreTypeCreateInfo;
+            stci.semaphoreType = vk::SemaphoreType::eTimeline;
+            stci.initialValue = 0;
+            vk::SemaphoreCreateInfo sci{};
+            sci.sType = vk::StructureType::eSemaphoreCreateInfo;
+            sci.pNext = &stci;
+            return device.createSemaphore(sci);
+        }
+    }// namespace
+
+    UploadContext::UploadContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc) : vmc(vmc), vcc(vcc)
+    {
+        transfer_timeline = create_timeline_semaphore(vmc.logical_device.get());
+        graphics_timeline = create_timeline_semaphore(vmc.logical_device.get());
+        begin_batch(1);
+    }
+
+    UploadContext::StagingRegion UploadContext::stage(const void* data, vk::DeviceSize size)
+    {
+        // oversized uploads would block the ring for everything else
+        if (size > vcc.staging_ring.get_size() / 2) return stage_dedicated(data, size);
+        std::optional<StagingRing::Allocation> allocation = vcc.staging_ring.allocate(size, staging_alignment);
+        if (!allocation.has_value())
+        {
+            reclaim();
+            allocation = vcc.staging_ring.allocate(size, staging_alignment);
+        }
+        if (!allocation.has_value())
+        {
+            // the ring is filled with data of transfers that are not finished yet
+            wait(transfer_timeline, submit().value);
+            reclaim();
+            allocation = vcc.staging_ring.allocate(size, staging_alignment);
+            if (!allocation.has_value()) return stage_dedicated(data, size);
+        }
+        memcpy(allocation->mapped, data, size);
+        vcc.staging_ring.flush(allocation.value(), size);
+        return {allocation->buffer, allocation->offset};
+    }
+
+    void UploadContext::copy_to_buffer(const void* data, vk::DeviceSize size, vk::Buffer dst_buffer, vk::DeviceSize dst_offset)
+    {
+        const StagingRegion region = stage(data, size);
+        vk::BufferCopy copy_region{};
+        copy_region.srcOffset = region.offset;
+        copy_region.dstOffset = dst_offset;
+        copy_region.size = size;
+        get_transfer_cb().copyBuffer(region.buffer, dst_buffer, copy_region);
+
+        if (vmc.queues_family_indices.transfer == vmc.queues_family_indices.graphics) return;
+        vk::BufferMemoryBarrier bmb{};
+        bmb.sType = vk::StructureType::eBufferMemoryBarrier;
+        bmb.srcQueueFamilyIndex = vmc.queues_family_indices.transfer;
+        bmb.dstQueueFamilyIndex = vmc.queues_family_indices.graphics;
+        bmb.buffer = dst_buffer;
+        bmb.offset = dst_offset;
+        bmb.size = size;
+        bmb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        bmb.dstAccessMask = {};
+        get_transfer_cb().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, bmb, {});
+        // the buffer can be used by any stage of later graphics submits
+        bmb.srcAccessMask = {};
+        bmb.dstAccessMask = vk::AccessFlagBits::eMemoryRead;
+        get_graphics_cb().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, {}, bmb, {});
+    }
+
+    void UploadContext::transfer_ownership(vk::Image image, vk::ImageLayout layout, uint32_t mip_levels)
+    {
+        if (vmc.queues_family_indices.transfer == vmc.queues_family_indices.graphics) return;
+        vk::ImageMemoryBarrier imb{};
+        imb.sType = vk::StructureType::eImageMemoryBarrier;
+        imb.oldLayout = layout;
+        imb.newLayout = layout;
+        imb.srcQueueFamilyIndex = vmc.queues_family_indices.transfer;
+        imb.dstQueueFamilyIndex = vmc.queues_family_indices.graphics;
+        imb.image = image;
+        imb.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        imb.subresourceRange.baseMipLevel = 0;
+        imb.subresourceRange.levelCount = mip_levels;
+        imb.subresourceRange.baseArrayLayer = 0;
+        imb.subresourceRange.layerCount = 1;
+        imb.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+        imb.dstAccessMask = {};
+        get_transfer_cb().pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, imb);
+        imb.srcAccessMask = {};
+        imb.dstAccessMask = vk::AccessFlagBits::eTransferRead | vk::AccessFlagBits::eTransferWrite;
+        get_graphics_cb().pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, imb);
+    }
+
+    const vk::CommandBuffer& UploadContext::get_transfer_cb()
+    {
+        recorded = true;
+        return recording.transfer_cb;
+    }
+
+    const vk::CommandBuffer& UploadContext::get_graphics_cb()
+    {
+        recorded = true;
+        return recording.graphics_cb;
+    }
+
+    UploadTicket UploadContext::get_ticket() const
+    {
+        return {recorded ? recording.value : submitted_value};
+    }
+
+    UploadContext::StagingRegion UploadContext::stage_dedicated(const void* data, vk::DeviceSize size)
+    {
+        if (recording.dedicated_size > 0 && recording.dedicated_size + size > max_dedicated_size) wait(transfer_timeline, submit().value);
+
+        vk::BufferCreateInfo bci{};
+        bci.sType = vk::StructureType::eBufferCreateInfo;
+        bci.size = size;
+        bci.usage = vk::BufferUsageFlagBits::eTransferSrc;
+        bci.sharingMode = vk::SharingMode::eExclusive;
+        VmaAllocationInfo vai;
+        const auto [staging_buffer, staging_vmaa] = vmc.memory_pools.create_buffer(bci, AllocationClass::Staging, VMA_ALLOCATION_CREATE_MAPPED_BIT, &vai);
+        memcpy(vai.pMappedData, data, size);
+        vmaFlushAllocation(vmc.va, staging_vmaa, 0, VK_WHOLE_SIZE);
+        recording.dedicated_buffers.push_back(std::make_pair(staging_buffer, staging_vmaa));
+        recording.dedicated_size += size;
+        return {staging_buffer, 0};
+    }
+
+    UploadTicket UploadContext::submit()
+    {
+        if (!recorded) return {submitted_value};
+        recording.transfer_cb.end();
+        recording.graphics_cb.end();
+        vcc.staging_ring.submit(recording.value);
+
+        vk::TimelineSemaphoreSubmitInfo tssi{};
+        tssi.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo;
+        tssi.signalSemaphoreValueCount = 1;
+        tssi.pSignalSemaphoreValues = &recording.value;
+        vk::SubmitInfo si{};
+        si.sType = vk::StructureType::eSubmitInfo;
+        si.pNext = &tssi;
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &recording.transfer_cb;
+        si.signalSemaphoreCount = 1;
+        si.pSignalSemaphores = &transfer_timeline;
+        vmc.get_transfer_queue().submit(si);
+
+        submitted_value = recording.value;
+        pending.push_back(std::move(recording));
+        begin_batch(submitted_value + 1);
+        reclaim();
+        return {submitted_value};
+    }
+
+    void UploadContext::acquire(UploadTicket ticket)
+    {
+        if (ticket.value > submitted_value) submit();
+        // batches are acquired in order to keep the values of the graphics timeline increasing
+        std::vector<vk::CommandBuffer> cbs;
+        uint64_t value = 0;
+        while (!pending.empty() && pending.front().value <= ticket.value)
+        {
+            cbs.push_back(pending.front().graphics_cb);
+            value = pending.front().value;
+            in_flight.push_back(std::move(pending.front()));
+            pending.pop_front();
+        }
+        if (cbs.empty()) return;
+
+        // the resources may be used by any stage of later graphics submits
+        const vk::PipelineStageFlags wait_stage = vk::PipelineStageFlagBits::eAllCommands;
+        vk::TimelineSemaphoreSubmitInfo tssi{};
+        tssi.sType = vk::StructureType::eTimelineSemaphoreSubmitInfo;
+        tssi.waitSemaphoreValueCount = 1;
+        tssi.pWaitSemaphoreValues = &value;
+        tssi.signalSemaphoreValueCount = 1;
+        tssi.pSignalSemaphoreValues = &value;
+        vk::SubmitInfo si{};
+        si.sType = vk::StructureType::eSubmitInfo;
+        si.pNext = &tssi;
+        si.waitSemaphoreCount = 1;
+        si.pWaitSemaphores = &transfer_timeline;
+        si.pWaitDstStageMask = &wait_stage;
+        si.commandBufferCount = cbs.size();
+        si.pCommandBuffers = cbs.data();
+        si.signalSemaphoreCount = 1;
+        si.pSignalSemaphores = &graphics_timeline;
+        vmc.get_graphics_queue().submit(si);
+    }
+
+    bool UploadContext::is_finished(UploadTicket ticket) const
+    {
+        return vmc.logical_device.get().getSemaphoreCounterValue(graphics_timeline) >= ticket.value;
+    }
+
+    bool UploadContext::is_idle() const
+    {
+        return !recorded && pending.empty() && is_finished({submitted_value});
+    }
+
+    void UploadContext::flush()
+    {
+        const UploadTicket ticket = submit();
+        acquire(ticket);
+        wait(graphics_timeline, ticket.value);
+        reclaim();
+    }
+
+    void UploadContext::self_destruct()
+    {
+        flush();
+        recording.transfer_cb.end();
+        recording.graphics_cb.end();
+        finished.push_back(std::move(recording));
+        for (auto& batch: finished)
+        {
+            vcc.command_pools[0].free_command_buffers({batch.graphics_cb});
+            vcc.command_pools[2].free_command_buffers({batch.transfer_cb});
+        }
+        finished.clear();
+        vmc.logical_device.get().destroySemaphore(transfer_timeline);
+        vmc.logical_device.get().destroySemaphore(graphics_timeline);
+    }
+
+    void UploadContext::begin_batch(uint64_t value)
+    {
+        if (finished.empty())
+        {
+            recording.graphics_cb = vcc.command_pools[0].create_command_buffers(1)[0];
+            recording.transfer_cb = vcc.command_pools[2].create_command_buffers(1)[0];
+            recording.dedicated_buffers.clear();
+            recording.dedicated_size = 0;
+        }
+        else
+        {
+            recording = std::move(finished.back());
+            finished.pop_back();
+        }
+        recording.value = value;
+        recorded = false;
+        vcc.begin(recording.transfer_cb);
+        vcc.begin(recording.graphics_cb);
+    }
+
+    void UploadContext::reclaim()
+    {
+        vcc.staging_ring.release(vmc.logical_device.get().getSemaphoreCounterValue(transfer_timeline));
+        const uint64_t graphics_value = vmc.logical_device.get().getSemaphoreCounterValue(graphics_timeline);
+        while (!in_flight.empty() && in_flight.front().value <= graphics_value)
+        {
+            Batch& batch = in_flight.front();
+            for (auto& staging_buffer: batch.dedicated_buffers)
+            {
+                vmc.memory_pools.destroy_buffer(staging_buffer.first, staging_buffer.second);
+            }
+            batch.dedicated_buffers.clear();
+            batch.dedicated_size = 0;
+            batch.transfer_cb.reset();
+            batch.graphics_cb.reset();
+            finished.push_back(std::move(batch));
+            in_flight.pop_front();
+        }
+    }
+
+    void UploadContext::wait(const vk::Semaphore& timeline, uint64_t value) const
+    {
+        vk::SemaphoreWaitInfo swi{};
+        swi.sType = vk::StructureType::eSemaphoreWaitInfo;
+        swi.semaphoreCount = 1;
+        swi.pSemaphores = &timeline;
+        swi.pValues = &value;
+        VE_CHECK(vmc.logical_device.get().waitSemaphores(swi, uint64_t(-1)), "Failed to wait for upload batch!");
+    }
+}// namespace ve
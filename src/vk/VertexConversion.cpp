@@ -0,0 +1,218 @@
+#include "vk/VertexConversion.hpp"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VE_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VE_SIMD_SSE
+#endif
+
+namespace ve
+{
+    namespace
+    {
+#if defined(VE_SIMD_AVX2)
+        using simd_float = __m256;
+        constexpr std::size_t simd_width = 8;
+
+        inline simd_float broadcast(float f)
+        {
+            return _mm256_set1_ps(f);
+        }
+
+        inline simd_float mul_add(simd_float a, simd_float b, simd_float c)
+        {
+#if defined(__FMA__)
+            return _mm256_fmadd_ps(a, b, c);
+#else
+            return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+        }
+
+        inline simd_float mul(simd_float a, simd_float b)
+        {
+            return _mm256_mul_ps(a, b);
+        }
+
+        inline simd_float div(simd_float a, simd_float b)
+        {
+            return _mm256_div_ps(a, b);
+        }
+
+        inline simd_float sqrt(simd_float a)
+        {
+            return _mm256_sqrt_ps(a);
+        }
+
+        // loads the same component of simd_width consecutive elements of a strided stream
+        inline simd_float load_strided(const float* data, std::size_t stride)
+        {
+            const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(int(stride)));
+            return _mm256_i32gather_ps(data, offsets, sizeof(float));
+        }
+
+        inline void store(float* dst, simd_float a)
+        {
+            _mm256_storeu_ps(dst, a);
+        }
+#elif defined(VE_SIMD_SSE)
+        using simd_float = __m128;
+        constexpr std::size_t simd_width = 4;
+
+        inline simd_float broadcast(float f)
+        {
+            return _mm_set1_ps(f);
+        }
+
+        inline simd_float mul_add(simd_float a, simd_float b, simd_float c)
+        {
+            return _mm_add_ps(_mm_mul_ps(a, b), c);
+        }
+
+        inline simd_float mul(simd_float a, simd_float b)
+        {
+            return _mm_mul_ps(a, b);
+        }
+
+        inline simd_float div(simd_float a, simd_float b)
+        {
+            return _mm_div_ps(a, b);
+        }
+
+        inline simd_float sqrt(simd_float a)
+        {
+            return _mm_sqrt_ps(a);
+        }
+
+        // loads the same component of simd_width consecutive elements of a strided stream
+        inline simd_float load_strided(const float* data, std::size_t stride)
+        {
+            return _mm_setr_ps(data[0], data[stride], data[2 * stride], data[3 * stride]);
+        }
+
+        inline void store(float* dst, simd_float a)
+        {
+            _mm_storeu_ps(dst, a);
+        }
+#endif
+
+#if defined(VE_SIMD_AVX2) || defined(VE_SIMD_SSE)
+        // processes the elements in blocks of simd_width in structure of arrays layout and returns the number of converted elements
+        std::size_t transform_positions_simd(const float* data, std::size_t stride, std::size_t count, const float* m, Vertex* vertices)
+        {
+            simd_float columns[16];
+            for (uint32_t i = 0; i < 16; ++i) columns[i] = broadcast(m[i]);
+            float x_out[simd_width], y_out[simd_width], z_out[simd_width];
+            std::size_t i = 0;
+            for (; i + simd_width <= count; i += simd_width)
+            {
+                const float* element = data + i * stride;
+                const simd_float x = load_strided(element, stride);
+                const simd_float y = load_strided(element + 1, stride);
+                const simd_float z = load_strided(element + 2, stride);
+                // glm matrices are column major, m[c * 4 + r] is the element in row r and column c
+                const simd_float tx = mul_add(columns[0], x, mul_add(columns[4], y, mul_add(columns[8], z, columns[12])));
+                const simd_float ty = mul_add(columns[1], x, mul_add(columns[5], y, mul_add(columns[9], z, columns[13])));
+                const simd_float tz = mul_add(columns[2], x, mul_add(columns[6], y, mul_add(columns[10], z, columns[14])));
+                const simd_float tw = mul_add(columns[3], x, mul_add(columns[7], y, mul_add(columns[11], z, columns[15])));
+                store(x_out, div(tx, tw));
+                store(y_out, div(ty, tw));
+                store(z_out, div(tz, tw));
+                for (std::size_t j = 0; j < simd_width; ++j) vertices[i + j].pos = glm::vec3(x_out[j], y_out[j], z_out[j]);
+            }
+            return i;
+        }
+
+        std::size_t normalize_normals_simd(const float* data, std::size_t stride, std::size_t count, Vertex* vertices)
+        {
+            const simd_float one = broadcast(1.0f);
+            float x_out[simd_width], y_out[simd_width], z_out[simd_width];
+            std::size_t i = 0;
+            for (; i + simd_width <= count; i += simd_width)
+            {
+                const float* element = data + i * stride;
+                const simd_float x = load_strided(element, stride);
+                const simd_float y = load_strided(element + 1, stride);
+                const simd_float z = load_strided(element + 2, stride);
+                // same as glm::normalize, zero length normals become NaN
+                const simd_float inv_length = div(one, sqrt(mul_add(x, x, mul_add(y, y, mul(z, z)))));
+                store(x_out, mul(x, inv_length));
+                store(y_out, mul(y, inv_length));
+                store(z_out, mul(z, inv_length));
+                for (std::size_t j = 0; j < simd_width; ++j) vertices[i + j].normal = glm::vec3(x_out[j], y_out[j], z_out[j]);
+            }
+            return i;
+        }
+#endif
+    }// namespace
+
+    void VertexConversion::transform_positions(AttributeStream positions, std::size_t count, const glm::mat4& matrix, Vertex* vertices)
+    {
+        const float* m = &matrix[0][0];
+        std::size_t i = 0;
+#if defined(VE_SIMD_AVX2) || defined(VE_SIMD_SSE)
+        i = transform_positions_simd(positions.data, positions.stride, count, m, vertices);
+#endif
+        for (; i < count; ++i)
+        {
+            const float* p = positions.data + i * positions.stride;
+            const float w = m[3] * p[0] + m[7] * p[1] + m[11] * p[2] + m[15];
+            vertices[i].pos = glm::vec3((m[0] * p[0] + m[4] * p[1] + m[8] * p[2] + m[12]) / w, (m[1] * p[0] + m[5] * p[1] + m[9] * p[2] + m[13]) / w, (m[2] * p[0] + m[6] * p[1] + m[10] * p[2] + m[14]) / w);
+        }
+    }
+
+    void VertexConversion::normalize_normals(AttributeStream normals, std::size_t count, Vertex* vertices)
+    {
+        std::size_t i = 0;
+#if defined(VE_SIMD_AVX2) || defined(VE_SIMD_SSE)
+        i = normalize_normals_simd(normals.data, normals.stride, count, vertices);
+#endif
+        for (; i < count; ++i)
+        {
+            const float* n = normals.data + i * normals.stride;
+            const float inv_length = 1.0f / std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            vertices[i].normal = glm::vec3(n[0] * inv_length, n[1] * inv_length, n[2] * inv_length);
+        }
+    }
+
+    void VertexConversion::copy_colors(AttributeStream colors, uint32_t component_count, std::size_t count, const glm::vec4& default_color, Vertex* vertices)
+    {
+        if (!colors.data)
+        {
+            for (std::size_t i = 0; i < count; ++i) vertices[i].color = default_color;
+        }
+        else if (component_count == 3)
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const float* c = colors.data + i * colors.stride;
+                vertices[i].color = glm::vec4(c[0], c[1], c[2], 1.0f);
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const float* c = colors.data + i * colors.stride;
+                vertices[i].color = glm::vec4(c[0], c[1], c[2], c[3]);
+            }
+        }
+    }
+
+    void VertexConversion::copy_tex_coords(AttributeStream tex_coords, std::size_t count, Vertex* vertices)
+    {
+        if (!tex_coords.data)
+        {
+            for (std::size_t i = 0; i < count; ++i) vertices[i].tex = glm::vec2(-1.0f);
+            return;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const float* t = tex_coords.data + i * tex_coords.stride;
+            vertices[i].tex = glm::vec2(t[0], t[1]);
+        }
+    }
+}// namespace ve
@@ -4,7 +4,7 @@
 
 namespace ve
 {
-        VulkanCommandContext::VulkanCommandContext(VulkanMainContext& vmc) : vmc(vmc), sync(vmc.logical_device.get())
+        VulkanCommandContext::VulkanCommandContext(VulkanMainContext& vmc) : vmc(vmc), sync(vmc.logical_device.get()), staging_ring(vmc, staging_ring_size)
         {
             command_pools.push_back(CommandPool(vmc.logical_device.get(), vmc.queues_family_indices.graphics));
             command_pools.push_back(CommandPool(vmc.logical_device.get(), vmc.queues_family_indices.compute));
@@ -57,6 +57,7 @@ namespace ve
         void VulkanCommandContext::self_destruct()
         {
             sync.wait_idle();
+            staging_ring.self_destruct();
             for (auto& command_pool: command_pools)
             {
                 command_pool.self_destruct();
@@ -7,21 +7,21 @@
 namespace ve
 {
     // create VulkanMainContext without window for non graphical applications
-    VulkanMainContext::VulkanMainContext() : instance({}), physical_device(instance, surface), logical_device(physical_device, queues_family_indices, queues)
+    VulkanMainContext::VulkanMainContext() : instance({}), physical_device(instance, surface), logical_device(physical_device, queues_family_indices, queues), va(create_vma_allocator()), memory_pools(logical_device, va), descriptor_set_layouts(logical_device)
     {
-        create_vma_allocator();
         VE_LOG_CONSOLE(VE_INFO, VE_C_PINK << "Created VulkanMainContext\n");
     }
 
     // create VulkanMainContext with window for graphical applications
-    VulkanMainContext::VulkanMainContext(const uint32_t width, const uint32_t height) : window(std::make_optional<Window>(width, height)), instance(window->get_required_extensions()), surface(window->create_surface(instance.get())), physical_device(instance, surface), logical_device(physical_device, queues_family_indices, queues)
+    VulkanMainContext::VulkanMainContext(const uint32_t width, const uint32_t height) : window(std::make_optional<Window>(width, height)), instance(window->get_required_extensions()), surface(window->create_surface(instance.get())), physical_device(instance, surface), logical_device(physical_device, queues_family_indices, queues), va(create_vma_allocator()), memory_pools(logical_device, va), descriptor_set_layouts(logical_device)
     {
-        create_vma_allocator();
         VE_LOG_CONSOLE(VE_INFO, VE_C_PINK << "Created VulkanMainContext\n");
     }
 
     void VulkanMainContext::self_destruct()
     {
+        descriptor_set_layouts.self_destruct();
+        memory_pools.self_destruct();
         vmaDestroyAllocator(va);
         if (surface.has_value()) instance.get().destroySurfaceKHR(surface.value());
         logical_device.self_destruct();
@@ -68,13 +68,17 @@ namespace ve
         return queues.at(QueueIndex::Present);
     }
 
-    void VulkanMainContext::create_vma_allocator()
+    VmaAllocator VulkanMainContext::create_vma_allocator() const
     {
         VmaAllocatorCreateInfo vaci{};
         vaci.instance = instance.get();
         vaci.physicalDevice = physical_device.get();
         vaci.device = logical_device.get();
         vaci.vulkanApiVersion = VK_API_VERSION_1_3;
-        vmaCreateAllocator(&vaci, &va);
+        // lets VMA query the real usage and budget of the heaps instead of estimating them from its own allocations
+        if (physical_device.is_extension_enabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) vaci.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        VmaAllocator allocator;
+        VE_CHECK(vk::Result(vmaCreateAllocator(&vaci, &allocator)), "Failed to create VMA allocator!");
+        return allocator;
     }
 }// namespace ve
\ No newline at end of file
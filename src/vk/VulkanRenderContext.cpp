@@ -6,7 +6,7 @@
 
 namespace ve
 {
-    VulkanRenderContext::VulkanRenderContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc) : vmc(vmc), vcc(vcc), swapchain(vmc, choose_sample_count()), scene(vmc, vcc)
+    VulkanRenderContext::VulkanRenderContext(const VulkanMainContext& vmc, VulkanCommandContext& vcc) : vmc(vmc), vcc(vcc), swapchain(vmc, choose_sample_count()), scene(vmc, vcc, frames_in_flight)
     {
         vcc.add_graphics_buffers(frames_in_flight);
         vcc.add_transfer_buffers(1);
@@ -16,7 +16,7 @@ namespace ve
         // add one descriptor set for every frame
         for (uint32_t i = 0; i < frames_in_flight; ++i)
         {
-            uniform_buffers.push_back(Buffer(vmc, std::vector<UniformBufferObject>{ubo}, vk::BufferUsageFlagBits::eUniformBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}));
+            uniform_buffers.push_back(Buffer(vmc, std::vector<UniformBufferObject>{ubo}, vk::BufferUsageFlagBits::eUniformBuffer, {uint32_t(vmc.queues_family_indices.transfer), uint32_t(vmc.queues_family_indices.graphics)}, AllocationClass::Uniform));
             scene.get_dsh(ShaderFlavor::Default).apply_descriptor_to_new_sets(0, uniform_buffers.back());
             scene.get_dsh(ShaderFlavor::Basic).apply_descriptor_to_new_sets(0, uniform_buffers.back());
             scene.add_bindings();
@@ -33,11 +33,15 @@ namespace ve
             sync_indices[SyncNames::FRenderFinished].push_back(vcc.sync.add_fence());
         }
 
+        vmc.memory_pools.log_stats();
+
         VE_LOG_CONSOLE(VE_INFO, VE_C_PINK << "Created VulkanRenderContext\n");
     }
 
     void VulkanRenderContext::self_destruct()
     {
+        // the scene returns its command buffers and staging memory to vcc, which therefore has to be destroyed afterwards
+        vcc.sync.wait_idle();
         for (auto& buffer: uniform_buffers)
         {
             buffer.self_destruct();
@@ -51,15 +55,21 @@ namespace ve
     void VulkanRenderContext::draw_frame(const Camera& camera, float time_diff)
     {
         total_time += time_diff;
+        if (total_time >= next_memory_log)
+        {
+            vmc.memory_pools.log_stats();
+            next_memory_log += memory_log_interval;
+        }
         ubo.M = glm::rotate(ubo.M, time_diff * glm::radians(90.f), glm::vec3(0.0f, 0.0f, 1.0f));
         scene.rotate("bunny", time_diff * 90.f, glm::vec3(0.0f, 1.0f, 0.0f));
         pc.MVP = camera.getVP() * ubo.M;
-        uniform_buffers[current_frame].update_data(ubo);
+        uniform_buffers[current_frame].write(ubo);
 
         vk::ResultValue<uint32_t> image_idx = vmc.logical_device.get().acquireNextImageKHR(swapchain.get(), uint64_t(-1), vcc.sync.get_semaphore(sync_indices[SyncNames::SImageAvailable][current_frame]));
         VE_CHECK(image_idx.result, "Failed to acquire next image!");
         vcc.sync.wait_for_fence(sync_indices[SyncNames::FRenderFinished][current_frame]);
         vcc.sync.reset_fence(sync_indices[SyncNames::FRenderFinished][current_frame]);
+        scene.update_defragmentation();
         record_graphics_command_buffer(image_idx.value, camera.getVP());
         submit_graphics(image_idx.value);
         current_frame = (current_frame + 1) % frames_in_flight;